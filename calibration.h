@@ -0,0 +1,233 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <type_traits>
+#ifdef ARDUINO_ARCH_ESP32
+#include <esp_partition.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "rgb_light.h"
+#include "white_light.h"
+
+namespace esphome {
+namespace rgbww {
+namespace yeelight_bs2 {
+
+// "YCAL", as stored in little-endian byte order.
+static const uint32_t CALIBRATION_MAGIC = 0x4C414359;
+static const uint16_t CALIBRATION_VERSION = 1;
+
+/**
+ * The header of a binary calibration image. All fields are little-endian,
+ * which is the native byte order of the ESP32.
+ */
+struct CalibrationHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t payload_size;
+    // CRC-32 (as used by zlib) over the payload.
+    uint32_t crc32;
+};
+
+/**
+ * The payload of a binary calibration image, directly following the
+ * header. The layout is exactly the in-memory layout of the tables as
+ * used by the RGBLight and WhiteLight classes (32 bit floats), so the
+ * tables can be used in place, without copying or parsing.
+ */
+struct CalibrationTables {
+    RGBCircle rgb_circle;
+    RGBWLevelsTable rgbw_levels_1;
+    RGBWLevelsTable rgbw_levels_100;
+};
+
+static_assert(sizeof(CalibrationHeader) == 16, "Unexpected calibration header layout");
+static_assert(std::is_standard_layout<CalibrationTables>::value && sizeof(CalibrationTables) == 4632,
+              "Unexpected calibration tables layout");
+
+inline uint32_t calibration_crc32(const uint8_t *data, size_t len)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+    return ~crc;
+}
+
+/**
+ * This class provides the calibration tables for the RGBLight and the
+ * WhiteLight classes.
+ *
+ * By default, the tables that are built into the firmware are used.
+ * Alternatively, a calibration image can be loaded from a flash partition.
+ * The partition is memory mapped, and after validating the header,
+ * checksum and table contents, the tables are used directly from flash.
+ * When the image is invalid, the built-in tables remain in use.
+ *
+ * On the host (for testing), a calibration image file can be memory
+ * mapped instead, using the same validation code path.
+ */
+class Calibration
+{
+public:
+    const RGBCircle *rgb_circle = &rgb_circle_;
+    const RGBWLevelsTable *rgbw_levels_1 = &rgbw_levels_1_;
+    const RGBWLevelsTable *rgbw_levels_100 = &rgbw_levels_100_;
+
+    /**
+     * Validates a calibration image. When valid, the tables point directly
+     * into the image data, which must stay available while in use.
+     */
+    bool load(const void *data, size_t size)
+    {
+        auto header = static_cast<const CalibrationHeader *>(data);
+        if (size < sizeof(CalibrationHeader) || header->magic != CALIBRATION_MAGIC)
+            return fail_("no calibration image found");
+        if (header->version != CALIBRATION_VERSION)
+            return fail_("unsupported calibration version");
+        if (header->header_size != sizeof(CalibrationHeader) ||
+            header->payload_size != sizeof(CalibrationTables) ||
+            size < header->header_size + header->payload_size)
+            return fail_("invalid calibration size");
+        auto payload = static_cast<const uint8_t *>(data) + header->header_size;
+        if (calibration_crc32(payload, header->payload_size) != header->crc32)
+            return fail_("calibration checksum mismatch");
+
+        auto tables = reinterpret_cast<const CalibrationTables *>(payload);
+        auto error = validate_(*tables);
+        if (error != nullptr)
+            return fail_(error);
+        rgb_circle = &tables->rgb_circle;
+        rgbw_levels_1 = &tables->rgbw_levels_1;
+        rgbw_levels_100 = &tables->rgbw_levels_100;
+        loaded_ = true;
+        error_ = nullptr;
+        return true;
+    }
+
+#ifdef ARDUINO_ARCH_ESP32
+    /**
+     * Memory maps the data partition with the provided label, and loads
+     * the calibration image from it.
+     */
+    bool map_partition(const char *label)
+    {
+        auto partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+        if (partition == nullptr)
+            return fail_("calibration partition not found");
+        const void *data;
+        spi_flash_mmap_handle_t handle;
+        if (esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &data, &handle) != ESP_OK)
+            return fail_("could not map calibration partition");
+        if (!load(data, partition->size)) {
+            spi_flash_munmap(handle);
+            return false;
+        }
+        return true;
+    }
+#else
+    ~Calibration()
+    {
+        if (mapped_ != nullptr)
+            munmap(mapped_, mapped_size_);
+    }
+
+    /**
+     * Memory maps the file with the provided path, and loads the
+     * calibration image from it.
+     */
+    bool map_file(const char *path)
+    {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0)
+            return fail_("calibration file not found");
+        struct stat info;
+        if (fstat(fd, &info) < 0 || info.st_size == 0) {
+            close(fd);
+            return fail_("invalid calibration file");
+        }
+        auto data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED)
+            return fail_("could not map calibration file");
+        if (!load(data, info.st_size)) {
+            munmap(data, info.st_size);
+            return false;
+        }
+        mapped_ = data;
+        mapped_size_ = info.st_size;
+        return true;
+    }
+#endif
+
+    bool is_loaded() const { return loaded_; }
+
+    /**
+     * Describes why the last load attempt failed.
+     */
+    const char *get_error() const { return error_; }
+
+protected:
+    bool loaded_ = false;
+    const char *error_ = nullptr;
+#ifndef ARDUINO_ARCH_ESP32
+    void *mapped_ = nullptr;
+    size_t mapped_size_ = 0;
+#endif
+
+    bool fail_(const char *error)
+    {
+        error_ = error;
+        return false;
+    }
+
+    static bool is_level_(float value)
+    {
+        // Written such that NaN is not a level.
+        return value >= 0.0f && value <= 1.0f;
+    }
+
+    /**
+     * The checksum only protects against corruption. A calibration that
+     * was edited by hand can still contain values that must not reach
+     * the LEDC outputs, or temperature rows that do not cover the full
+     * color temperature range (for which WhiteLight would throw).
+     * Returns an error, or nullptr when the tables are valid.
+     */
+    static const char *validate_(const CalibrationTables &tables)
+    {
+        for (auto &ring : tables.rgb_circle)
+            for (auto &point : ring)
+                if (!is_level_(point.low.red) || !is_level_(point.low.green) || !is_level_(point.low.blue) ||
+                    !is_level_(point.high.red) || !is_level_(point.high.green) || !is_level_(point.high.blue))
+                    return "calibration RGB level out of range";
+        for (auto table : { &tables.rgbw_levels_1, &tables.rgbw_levels_100 }) {
+            float previous = INFINITY;
+            for (auto &row : *table) {
+                if (!is_level_(row.red) || !is_level_(row.green) || !is_level_(row.blue) || !is_level_(row.white))
+                    return "calibration white level out of range";
+                if (!(row.from_temperature < previous))
+                    return "calibration temperatures not descending";
+                previous = row.from_temperature;
+            }
+            if (!(previous <= MIRED_MAX))
+                return "calibration temperatures do not cover the full range";
+        }
+        return nullptr;
+    }
+};
+
+} // namespace yeelight_bs2
+} // namespace rgbww
+} // namespace esphome
@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+#
+# This script creates binary calibration images for the yeelight_bs2
+# component. Such an image can be written to a dedicated flash partition,
+# so the color calibration can be changed without reflashing the firmware.
+#
+# Usage:
+#
+#   Export the calibration tables that are built into the firmware:
+#   ./make_calibration.py export calibration.json
+#
+#   Create a binary calibration image from a (modified) JSON file:
+#   ./make_calibration.py build calibration.json calibration.bin
+
+import json
+import math
+import os
+import re
+import struct
+import sys
+import zlib
+
+MAGIC = 0x4C414359  # "YCAL"
+VERSION = 1
+HEADER_FORMAT = "<IHHII"
+RINGS = 7
+RING_POSITIONS = 24
+TEMPERATURES = 15
+# The coolest supported color temperature (mireds). The last row of a
+# white table must start at or below this temperature.
+MIRED_MAX = 153
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "..")
+FLOAT = r"([-0-9.]+)f?"
+
+
+def read_table(source, name):
+    start = source.index(name + " {{")
+    end = source.index("}};", start)
+    return source[start:end]
+
+
+def export(json_path):
+    with open(os.path.join(ROOT, "rgb_light.h")) as f:
+        rgb_source = f.read()
+    with open(os.path.join(ROOT, "white_light.h")) as f:
+        white_source = f.read()
+
+    point = re.compile(r"\{\{\s*%s,\s*%s,\s*%s\s*\},\s*\{\s*%s,\s*%s,\s*%s\s*\}\}" % ((FLOAT,) * 6))
+    points = [[float(v) for v in m] for m in point.findall(read_table(rgb_source, "rgb_circle_"))]
+    if len(points) != RINGS * RING_POSITIONS:
+        sys.exit("Unexpected number of RGB circle points: %d" % len(points))
+
+    level = re.compile(r"\{\s*%s,\s*%s,\s*%s,\s*%s,\s*%s\s*\}" % ((FLOAT,) * 5))
+    levels = {}
+    for name in ("rgbw_levels_1_", "rgbw_levels_100_"):
+        rows = [[float(v) for v in m] for m in level.findall(read_table(white_source, name))]
+        if len(rows) != TEMPERATURES:
+            sys.exit("Unexpected number of rows in %s: %d" % (name, len(rows)))
+        levels[name.rstrip("_")] = rows
+
+    calibration = {
+        # Per ring, per position: [low red, green, blue, high red, green, blue]
+        "rgb_circle": [points[i:i + RING_POSITIONS] for i in range(0, len(points), RING_POSITIONS)],
+        # Per row: [from temperature, red, green, blue, white]
+        "rgbw_levels_1": levels["rgbw_levels_1"],
+        "rgbw_levels_100": levels["rgbw_levels_100"],
+    }
+    with open(json_path, "w") as f:
+        json.dump(calibration, f, indent=1)
+
+
+def is_level(value):
+    return isinstance(value, (int, float)) and math.isfinite(value) and 0 <= value <= 1
+
+
+def build(json_path, bin_path):
+    with open(json_path) as f:
+        calibration = json.load(f)
+
+    values = []
+    if len(calibration["rgb_circle"]) != RINGS:
+        sys.exit("rgb_circle must contain %d rings" % RINGS)
+    for ring in calibration["rgb_circle"]:
+        if len(ring) != RING_POSITIONS or any(len(p) != 6 for p in ring):
+            sys.exit("Each ring must contain %d points of 6 values" % RING_POSITIONS)
+        for p in ring:
+            if not all(is_level(v) for v in p):
+                sys.exit("RGB circle values must be between 0 and 1: %s" % p)
+            values.extend(p)
+    for name in ("rgbw_levels_1", "rgbw_levels_100"):
+        rows = calibration[name]
+        if len(rows) != TEMPERATURES or any(len(r) != 5 for r in rows):
+            sys.exit("%s must contain %d rows of 5 values" % (name, TEMPERATURES))
+        for r in rows:
+            if not all(is_level(v) for v in r[1:]):
+                sys.exit("%s levels must be between 0 and 1: %s" % (name, r))
+            values.extend(r)
+        temperatures = [r[0] for r in rows]
+        if not all(isinstance(t, (int, float)) and math.isfinite(t) for t in temperatures) or \
+                any(a <= b for a, b in zip(temperatures, temperatures[1:])):
+            sys.exit("%s temperatures must be strictly descending" % name)
+        if temperatures[-1] > MIRED_MAX:
+            sys.exit("The last row of %s must start at or below %d mireds" % (name, MIRED_MAX))
+
+    payload = struct.pack("<%df" % len(values), *values)
+    header = struct.pack(
+        HEADER_FORMAT, MAGIC, VERSION, struct.calcsize(HEADER_FORMAT),
+        len(payload), zlib.crc32(payload) & 0xFFFFFFFF)
+    with open(bin_path, "wb") as f:
+        f.write(header + payload)
+
+
+if __name__ == "__main__":
+    if len(sys.argv) == 3 and sys.argv[1] == "export":
+        export(sys.argv[2])
+    elif len(sys.argv) == 4 and sys.argv[1] == "build":
+        build(sys.argv[2], sys.argv[3])
+    else:
+        sys.exit("Usage: make_calibration.py export <json> | build <json> <bin>")
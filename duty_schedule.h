@@ -0,0 +1,199 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+
+namespace esphome {
+namespace rgbww {
+namespace yeelight_bs2 {
+
+// The number of duty cycle ticks that the LEDC outputs can represent.
+// The ledc component picks the highest bit depth that still supports the
+// configured PWM frequency. For 3000Hz, that is 14 bits (80MHz / 2^14 =
+// 4882Hz). When changing the PWM frequency, update this value as well.
+static const float LEDC_DUTY_TICKS = (1 << 14) - 1;
+
+// Upper bound for the difference between a duty cycle as computed by the
+// RGBLight and WhiteLight classes and the exact linear function of the
+// brightness that it represents. This covers the single precision rounding
+// in the color computation, and in the conversion to ticks by the ledc
+// output: a handful of roundings of values up to 1, of 6e-8 at most each.
+static const double DUTY_ROUNDING_ERROR = 5e-7;
+
+enum LightMode {
+    LIGHT_MODE_OFF,
+    LIGHT_MODE_WHITE,
+    LIGHT_MODE_RGB,
+    LIGHT_MODE_NIGHT
+};
+
+// Duty cycles for the red, green, blue and white channel.
+using DutyCycles = std::array<float, 4>;
+
+/**
+ * This class keeps track of the brightness range within which the LED
+ * duty cycles will not change by a single LEDC tick.
+ *
+ * During a transition, ESPHome calls write_state() on every loop
+ * iteration. For slow transitions, most of these calls result in the
+ * exact same duty cycles as the previous call. For a given color (RGB
+ * or color temperature), the duty cycles as computed by the RGBLight
+ * and WhiteLight classes are linear in the brightness. Therefore, the
+ * first and the last computed frame for a color are enough to determine
+ * at what brightness
+ * the next duty tick change will occur on any of the channels. Until that
+ * brightness is reached, the color computation can be skipped.
+ *
+ * When the color or the light mode changes between frames (e.g. when
+ * transitioning from one color to another), no window is available
+ * and every frame is computed.
+ */
+class DutySchedule
+{
+public:
+    /**
+     * Returns true when the provided input would produce the same LEDC
+     * duty ticks as the last computed frame.
+     */
+    bool can_skip(LightMode mode, float red, float green, float blue,
+                  float temperature, float brightness)
+    {
+        if (!has_window_ || !same_color_(mode, red, green, blue, temperature))
+            return false;
+        if (mode == LIGHT_MODE_NIGHT)
+            return true;
+        return brightness > window_low_ && brightness < window_high_;
+    }
+
+    /**
+     * Registers a computed frame, and determines the brightness window
+     * within which the next frames can be skipped.
+     */
+    void record(LightMode mode, float red, float green, float blue,
+                float temperature, float brightness, DutyCycles duties)
+    {
+        // The first frame for a new color is used as the anchor from which
+        // the slopes of the duty cycle lines are determined.
+        if (!has_anchor_ ||
+            !same_color_(mode, red, green, blue, temperature) ||
+            !is_linear_(mode, anchor_brightness_, anchor_duties_)) {
+            mode_ = mode;
+            red_ = red;
+            green_ = green;
+            blue_ = blue;
+            temperature_ = temperature;
+            anchor_brightness_ = brightness;
+            anchor_duties_ = duties;
+            has_anchor_ = true;
+            has_window_ = mode == LIGHT_MODE_NIGHT;
+            return;
+        }
+
+        has_window_ = brightness != anchor_brightness_ && is_linear_(mode, brightness, duties);
+        if (has_window_)
+            compute_window_(mode, brightness, duties);
+    }
+
+    void reset()
+    {
+        has_anchor_ = false;
+        has_window_ = false;
+    }
+
+protected:
+    bool has_anchor_ = false;
+    bool has_window_ = false;
+    LightMode mode_ = LIGHT_MODE_OFF;
+    float red_ = 0;
+    float green_ = 0;
+    float blue_ = 0;
+    float temperature_ = 0;
+    float anchor_brightness_ = 0;
+    DutyCycles anchor_duties_ {};
+    double window_low_ = 0;
+    double window_high_ = 0;
+
+    bool same_color_(LightMode mode, float red, float green, float blue, float temperature)
+    {
+        return mode == mode_ &&
+            red == red_ && green == green_ && blue == blue_ &&
+            temperature == temperature_;
+    }
+
+    /**
+     * Checks if a frame lies within the range in which the duty cycles
+     * are linear in the brightness. The WhiteLight clamps the brightness
+     * at 1%, and the RGBLight snaps low red duty cycles to zero.
+     */
+    bool is_linear_(LightMode mode, float brightness, const DutyCycles &duties)
+    {
+        if (mode == LIGHT_MODE_WHITE)
+            return brightness >= 0.01f && brightness <= 1.0f;
+        if (mode == LIGHT_MODE_RGB)
+            return duties[0] >= 0.01f;
+        return false;
+    }
+
+    /**
+     * Determines the brightness range around the provided frame, within
+     * which no channel can reach another duty tick.
+     *
+     * The slopes are determined from the difference with the anchor frame.
+     * Because both frames contain rounding errors, the slopes are not exact.
+     * Close to the anchor, this error is large compared to the slope itself,
+     * so the window is computed for the worst case slope within the error
+     * bounds. The computation is done in double precision, to not add new
+     * rounding errors.
+     */
+    void compute_window_(LightMode mode, float brightness, const DutyCycles &duties)
+    {
+        double b = brightness;
+        double low = mode == LIGHT_MODE_WHITE ? 0.01 : -INFINITY;
+        double high = mode == LIGHT_MODE_WHITE ? 1.0 : INFINITY;
+
+        double d_brightness = b - anchor_brightness_;
+        double slope_error = 2 * DUTY_ROUNDING_ERROR / fabs(d_brightness);
+        for (size_t i = 0; i < duties.size(); i++) {
+            double duty = duties[i];
+            double slope = (duty - anchor_duties_[i]) / d_brightness;
+
+            // Room between the duty cycle and the duty cycles that are rounded
+            // to the next higher / lower tick. The next frame can be off from
+            // the line by the rounding error, and so can this one.
+            auto tick = round(duty * LEDC_DUTY_TICKS);
+            double room_up = (tick + 0.5) / LEDC_DUTY_TICKS - duty - 2 * DUTY_ROUNDING_ERROR;
+            double room_down = duty - (tick - 0.5) / LEDC_DUTY_TICKS - 2 * DUTY_ROUNDING_ERROR;
+
+            // Below this duty cycle, the RGBLight snaps red to zero.
+            if (i == 0 && mode == LIGHT_MODE_RGB)
+                room_down = fmin(room_down, duty - 0.01 - 2 * DUTY_ROUNDING_ERROR);
+
+            // Too close to a tick boundary to tell on what side the next
+            // frame will end up.
+            if (room_up <= 0 || room_down <= 0) {
+                low = high = b;
+                break;
+            }
+
+            // The fastest possible rise and fall of the duty cycle, per unit
+            // of brightness increase.
+            double rise = slope + slope_error;
+            double fall = slope_error - slope;
+            if (rise > 0) {
+                high = fmin(high, b + room_up / rise);
+                low = fmax(low, b - room_down / rise);
+            }
+            if (fall > 0) {
+                high = fmin(high, b + room_down / fall);
+                low = fmax(low, b - room_up / fall);
+            }
+        }
+
+        window_low_ = low;
+        window_high_ = high;
+    }
+};
+
+} // namespace yeelight_bs2
+} // namespace rgbww
+} // namespace esphome
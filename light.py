@@ -1,14 +1,66 @@
 import esphome.codegen as cg
 import esphome.config_validation as cv
 import esphome.components.gpio.output as gpio_output
-from esphome.components import light, gpio, ledc
-from esphome.const import CONF_RED, CONF_GREEN, CONF_BLUE, CONF_WHITE, CONF_OUTPUT_ID
+from esphome import pins
+from esphome.components import light, gpio, ledc, i2c
+from esphome.const import CONF_RED, CONF_GREEN, CONF_BLUE, CONF_WHITE, CONF_OUTPUT_ID, CONF_ID, CONF_PORT, CONF_TIMEOUT
 
 CONF_MASTER1 = "master1"
 CONF_MASTER2 = "master2"
+CONF_LAN_SERVER = "lan_server"
+CONF_STREAM_SERVER = "stream_server"
+CONF_GROUP_SYNC = "group_sync"
+CONF_GROUP = "group"
+CONF_LEADER = "leader"
+CONF_BROADCAST_ADDRESS = "broadcast_address"
+CONF_LEAD_TIME = "lead_time"
+CONF_SYNC_INTERVAL = "sync_interval"
+CONF_FRONT_PANEL = "front_panel"
+CONF_TRIGGER_PIN = "trigger_pin"
+CONF_SLIDER_TRANSITION = "slider_transition"
+CONF_CALIBRATION_PARTITION = "calibration_partition"
 
 rgbww_ns = cg.esphome_ns.namespace("rgbww")
 YeelightBS2LightOutput = rgbww_ns.class_("YeelightBS2LightOutput", light.LightOutput)
+YeelightLanServer = rgbww_ns.class_("YeelightLanServer", cg.Component)
+YeelightStreamServer = rgbww_ns.class_("YeelightStreamServer", cg.Component)
+YeelightGroupSync = rgbww_ns.class_("YeelightGroupSync", cg.Component)
+YeelightFrontPanel = rgbww_ns.class_("YeelightFrontPanel", cg.Component, i2c.I2CDevice)
+
+LAN_SERVER_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(): cv.declare_id(YeelightLanServer),
+        cv.Optional(CONF_PORT, default=55443): cv.port,
+    }
+).extend(cv.COMPONENT_SCHEMA)
+
+STREAM_SERVER_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(): cv.declare_id(YeelightStreamServer),
+        cv.Optional(CONF_PORT, default=4048): cv.port,
+        cv.Optional(CONF_TIMEOUT, default="2500ms"): cv.positive_time_period_milliseconds,
+    }
+).extend(cv.COMPONENT_SCHEMA)
+
+GROUP_SYNC_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(): cv.declare_id(YeelightGroupSync),
+        cv.Optional(CONF_LEADER, default=False): cv.boolean,
+        cv.Optional(CONF_GROUP, default=0): cv.uint8_t,
+        cv.Optional(CONF_PORT, default=55444): cv.port,
+        cv.Optional(CONF_BROADCAST_ADDRESS, default="255.255.255.255"): cv.ipv4,
+        cv.Optional(CONF_LEAD_TIME, default="150ms"): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_SYNC_INTERVAL, default="2s"): cv.positive_time_period_milliseconds,
+    }
+).extend(cv.COMPONENT_SCHEMA)
+
+FRONT_PANEL_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(): cv.declare_id(YeelightFrontPanel),
+        cv.Required(CONF_TRIGGER_PIN): pins.gpio_input_pin_schema,
+        cv.Optional(CONF_SLIDER_TRANSITION, default="100ms"): cv.positive_time_period_milliseconds,
+    }
+).extend(cv.COMPONENT_SCHEMA).extend(i2c.i2c_device_schema(0x2C))
 
 CONFIG_SCHEMA = light.RGB_LIGHT_SCHEMA.extend(
     {
@@ -20,6 +72,11 @@ CONFIG_SCHEMA = light.RGB_LIGHT_SCHEMA.extend(
         cv.Required(CONF_WHITE): cv.use_id(ledc),
         cv.Required(CONF_MASTER1): cv.use_id(gpio_output.GPIOBinaryOutput),
         cv.Required(CONF_MASTER2): cv.use_id(gpio_output.GPIOBinaryOutput),
+        cv.Optional(CONF_LAN_SERVER): LAN_SERVER_SCHEMA,
+        cv.Optional(CONF_STREAM_SERVER): STREAM_SERVER_SCHEMA,
+        cv.Optional(CONF_GROUP_SYNC): GROUP_SYNC_SCHEMA,
+        cv.Optional(CONF_FRONT_PANEL): FRONT_PANEL_SCHEMA,
+        cv.Optional(CONF_CALIBRATION_PARTITION): cv.string,
     }
 )
 
@@ -44,3 +101,49 @@ def to_code(config):
 
     master2 = yield cg.get_variable(config[CONF_MASTER2])
     cg.add(var.set_master2_output(master2))
+
+    if CONF_CALIBRATION_PARTITION in config:
+        cg.add(var.load_calibration(config[CONF_CALIBRATION_PARTITION]))
+
+    if CONF_LAN_SERVER in config:
+        conf = config[CONF_LAN_SERVER]
+        server = cg.new_Pvariable(conf[CONF_ID])
+        yield cg.register_component(server, conf)
+        light_state = yield cg.get_variable(config[CONF_ID])
+        cg.add(server.set_light_state(light_state))
+        cg.add(server.set_output(var))
+        cg.add(server.set_port(conf[CONF_PORT]))
+
+    if CONF_STREAM_SERVER in config:
+        conf = config[CONF_STREAM_SERVER]
+        server = cg.new_Pvariable(conf[CONF_ID])
+        yield cg.register_component(server, conf)
+        cg.add(server.set_output(var))
+        cg.add(server.set_port(conf[CONF_PORT]))
+        cg.add(server.set_timeout(conf[CONF_TIMEOUT]))
+
+    if CONF_GROUP_SYNC in config:
+        conf = config[CONF_GROUP_SYNC]
+        sync = cg.new_Pvariable(conf[CONF_ID])
+        yield cg.register_component(sync, conf)
+        light_state = yield cg.get_variable(config[CONF_ID])
+        cg.add(sync.set_light_state(light_state))
+        cg.add(sync.set_leader(conf[CONF_LEADER]))
+        cg.add(sync.set_group(conf[CONF_GROUP]))
+        cg.add(sync.set_port(conf[CONF_PORT]))
+        cg.add(sync.set_broadcast_address(str(conf[CONF_BROADCAST_ADDRESS])))
+        cg.add(sync.set_lead_time(conf[CONF_LEAD_TIME]))
+        cg.add(sync.set_sync_interval(conf[CONF_SYNC_INTERVAL]))
+
+    if CONF_FRONT_PANEL in config:
+        conf = config[CONF_FRONT_PANEL]
+        cg.add_define("USE_YEELIGHT_BS2_FRONT_PANEL")
+        panel = cg.new_Pvariable(conf[CONF_ID])
+        yield cg.register_component(panel, conf)
+        yield i2c.register_i2c_device(panel, conf)
+        light_state = yield cg.get_variable(config[CONF_ID])
+        cg.add(panel.set_light_state(light_state))
+        cg.add(panel.set_output(var))
+        trigger_pin = yield cg.gpio_pin_expression(conf[CONF_TRIGGER_PIN])
+        cg.add(panel.set_trigger_pin(trigger_pin))
+        cg.add(panel.set_slider_transition(conf[CONF_SLIDER_TRANSITION]))
@@ -243,13 +243,24 @@ public:
     float blue = 0;
     float white = 0;
 
+    /**
+     * Sets the color circle to use for the RGB mapping. The table is not
+     * copied, so it must stay available while in use (e.g. a calibration
+     * table that is memory mapped from flash).
+     */
+    void set_rgb_circle(const RGBCircle *circle)
+    {
+        rgb_circle_ptr_ = circle;
+    }
+
     void set_color(float red, float green, float blue, float brightness, float state)
     {
         // Determine the ring level for the color. This is a value between
-        // 0 and 7, determining in what ring of the RGB circle the requested
-        // color resides.
+        // 0 and 6, determining in what ring of the RGB circle the requested
+        // color resides. There are no measurements for the white center
+        // point, so colors between ring 7 and the center use ring 7.
         auto rgb_min = min(min(red, green), blue);
-        auto ring_level = 7.0f * rgb_min;
+        auto ring_level = min(7.0f * rgb_min, 6.0f);
         auto ring_level_a = floor(ring_level);
         auto ring_level_b = ceil(ring_level);
 
@@ -260,8 +271,8 @@ public:
         // interpolation will be done to get the final outputs.
         // We'll start here by determining the ring above and below the
         // ring level.
-        auto ring_a = rgb_circle_[ring_level_a];
-        auto ring_b = rgb_circle_[ring_level_b];
+        const auto &ring_a = (*rgb_circle_ptr_)[ring_level_a];
+        const auto &ring_b = (*rgb_circle_ptr_)[ring_level_b];
 
         // Now we have the two rings to work with, we'll have to look at the
         // positions on these rings to determine the RGB value to use for
@@ -363,6 +374,8 @@ public:
     }
 
 protected:
+    const RGBCircle *rgb_circle_ptr_ = &rgb_circle_;
+
     /**
      * Returns the position on an RGB ring in degrees (0 - 359).
      */
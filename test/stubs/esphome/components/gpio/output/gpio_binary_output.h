@@ -0,0 +1,18 @@
+#pragma once
+
+namespace esphome {
+namespace gpio {
+
+class GPIOBinaryOutput
+{
+public:
+    void turn_on() { state_ = true; }
+    void turn_off() { state_ = false; }
+    bool get_state() const { return state_; }
+
+protected:
+    bool state_ = false;
+};
+
+} // namespace gpio
+} // namespace esphome
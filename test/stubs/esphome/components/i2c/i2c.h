@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace esphome {
+namespace i2c {
+
+/**
+ * Records what is written to the device, and returns the data that the
+ * test provided for the next read.
+ */
+class I2CDevice
+{
+public:
+    bool write_bytes_raw(const uint8_t *data, uint8_t len)
+    {
+        writes.emplace_back(data, data + len);
+        return true;
+    }
+
+    bool read_bytes_raw(uint8_t *data, uint8_t len)
+    {
+        if (len > next_read.size())
+            return false;
+        memcpy(data, next_read.data(), len);
+        return true;
+    }
+
+    void set_i2c_address(uint8_t address) { address_ = address; }
+
+    std::vector<std::vector<uint8_t>> writes;
+    std::array<uint8_t, 7> next_read {};
+
+protected:
+    uint8_t address_ = 0;
+};
+
+} // namespace i2c
+} // namespace esphome
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+namespace esphome {
+namespace ledc {
+
+/**
+ * Records the duty cycle in ticks, like the ledc output writes it to the
+ * LEDC peripheral. At 3000Hz, the ledc output uses 14 bits.
+ */
+class LEDCOutput
+{
+public:
+    void set_frequency(float frequency) { frequency_ = frequency; }
+
+    void set_level(float state)
+    {
+        const uint32_t max_duty = (uint32_t(1) << bit_depth_) - 1;
+        duty_ = static_cast<uint32_t>(roundf(state * max_duty));
+        writes_++;
+    }
+
+    void turn_off() { set_level(0.0f); }
+
+    uint32_t get_duty() const { return duty_; }
+    uint32_t get_writes() const { return writes_; }
+
+protected:
+    float frequency_ = 1000.0f;
+    uint8_t bit_depth_ = 14;
+    uint32_t duty_ = 0;
+    uint32_t writes_ = 0;
+};
+
+} // namespace ledc
+} // namespace esphome
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "esphome/core/component.h"
+
+namespace esphome {
+namespace light {
+
+class LightTraits
+{
+public:
+    void set_supports_brightness(bool supports) {}
+    void set_supports_rgb(bool supports) {}
+    void set_supports_rgb_white_value(bool supports) {}
+    void set_supports_color_temperature(bool supports) {}
+    void set_supports_color_interlock(bool supports) {}
+    void set_min_mireds(float mireds) {}
+    void set_max_mireds(float mireds) {}
+};
+
+/**
+ * The subset of LightColorValues (ESPHome 1.17) that is used by the
+ * component. With color interlock, white is 1 in color temperature mode
+ * and 0 in RGB mode.
+ */
+class LightColorValues
+{
+public:
+    static LightColorValues lerp(const LightColorValues &start, const LightColorValues &end, float completion)
+    {
+        LightColorValues v;
+        v.state_ = start.state_ + completion * (end.state_ - start.state_);
+        v.brightness_ = start.brightness_ + completion * (end.brightness_ - start.brightness_);
+        v.red_ = start.red_ + completion * (end.red_ - start.red_);
+        v.green_ = start.green_ + completion * (end.green_ - start.green_);
+        v.blue_ = start.blue_ + completion * (end.blue_ - start.blue_);
+        v.white_ = start.white_ + completion * (end.white_ - start.white_);
+        v.color_temperature_ = start.color_temperature_ + completion * (end.color_temperature_ - start.color_temperature_);
+        return v;
+    }
+
+    float get_state() const { return state_; }
+    void set_state(float state) { state_ = state; }
+    float get_brightness() const { return brightness_; }
+    void set_brightness(float brightness) { brightness_ = brightness; }
+    float get_red() const { return red_; }
+    void set_red(float red) { red_ = red; }
+    float get_green() const { return green_; }
+    void set_green(float green) { green_ = green; }
+    float get_blue() const { return blue_; }
+    void set_blue(float blue) { blue_ = blue; }
+    float get_white() const { return white_; }
+    void set_white(float white) { white_ = white; }
+    float get_color_temperature() const { return color_temperature_; }
+    void set_color_temperature(float color_temperature) { color_temperature_ = color_temperature; }
+
+protected:
+    float state_ = 0.0f;
+    float brightness_ = 1.0f;
+    float red_ = 1.0f;
+    float green_ = 1.0f;
+    float blue_ = 1.0f;
+    float white_ = 1.0f;
+    float color_temperature_ = 370.0f;
+};
+
+class LightState;
+
+class LightOutput
+{
+public:
+    virtual ~LightOutput() = default;
+    virtual LightTraits get_traits() = 0;
+    virtual void write_state(LightState *state) = 0;
+};
+
+} // namespace light
+} // namespace esphome
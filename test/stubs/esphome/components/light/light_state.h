@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "esphome/core/component.h"
+#include "esphome/components/light/light_output.h"
+
+namespace esphome {
+namespace light {
+
+class LightCall;
+
+/**
+ * Models how LightState (ESPHome 1.17) drives its output: a performed
+ * call updates the remote values and starts a transition right away, but
+ * write_state() is only called from loop().
+ */
+class LightState : public Component
+{
+public:
+    LightColorValues current_values;
+    LightColorValues remote_values;
+
+    explicit LightState(LightOutput *output = nullptr) : output_(output) {}
+
+    LightCall make_call();
+    LightCall toggle();
+    LightCall turn_on();
+    LightCall turn_off();
+
+    void add_new_remote_values_callback(std::function<void()> &&callback)
+    {
+        remote_values_callbacks_.push_back(std::move(callback));
+    }
+
+    LightOutput *get_output() const { return output_; }
+
+    void loop() override
+    {
+        if (transition_length_ > 0) {
+            auto progress = (millis() - transition_start_) / float(transition_length_);
+            if (progress >= 1.0f) {
+                current_values = transition_end_;
+                transition_length_ = 0;
+            } else {
+                // Smoothstep, like LightTransitionTransformer.
+                auto smoothed = progress * progress * (3.0f - 2.0f * progress);
+                current_values = LightColorValues::lerp(transition_start_values_, transition_end_, smoothed);
+            }
+            next_write_ = true;
+        }
+        if (next_write_) {
+            next_write_ = false;
+            if (output_ != nullptr)
+                output_->write_state(this);
+        }
+    }
+
+    bool is_transitioning() const { return transition_length_ > 0; }
+
+protected:
+    friend LightCall;
+
+    LightOutput *output_;
+    std::vector<std::function<void()>> remote_values_callbacks_;
+    LightColorValues transition_start_values_;
+    LightColorValues transition_end_;
+    uint32_t transition_start_ = 0;
+    uint32_t transition_length_ = 0;
+    bool next_write_ = false;
+
+    void apply_(const LightColorValues &target, uint32_t transition_length)
+    {
+        remote_values = target;
+        if (transition_length == 0) {
+            current_values = target;
+            transition_length_ = 0;
+        } else {
+            transition_start_values_ = current_values;
+            transition_end_ = target;
+            transition_start_ = millis();
+            transition_length_ = transition_length;
+        }
+        next_write_ = true;
+        for (auto &callback : remote_values_callbacks_)
+            callback();
+    }
+};
+
+class LightCall
+{
+public:
+    explicit LightCall(LightState *parent) : parent_(parent), values_(parent->remote_values) {}
+
+    LightCall &set_state(bool state)
+    {
+        values_.set_state(state ? 1.0f : 0.0f);
+        return *this;
+    }
+
+    LightCall &set_brightness(float brightness)
+    {
+        values_.set_brightness(brightness);
+        return *this;
+    }
+
+    // Color interlock, without RGB white value support: any RGB color
+    // switches to RGB mode.
+    LightCall &set_rgb(float red, float green, float blue)
+    {
+        values_.set_red(red);
+        values_.set_green(green);
+        values_.set_blue(blue);
+        values_.set_white(0.0f);
+        return *this;
+    }
+
+    LightCall &set_color_temperature(float color_temperature)
+    {
+        values_.set_color_temperature(color_temperature);
+        values_.set_red(1.0f);
+        values_.set_green(1.0f);
+        values_.set_blue(1.0f);
+        values_.set_white(1.0f);
+        return *this;
+    }
+
+    LightCall &set_transition_length(uint32_t transition_length)
+    {
+        transition_length_ = transition_length;
+        return *this;
+    }
+
+    void perform() { parent_->apply_(values_, transition_length_); }
+
+protected:
+    LightState *parent_;
+    LightColorValues values_;
+    uint32_t transition_length_ = 0;
+};
+
+inline LightCall LightState::make_call() { return LightCall(this); }
+
+inline LightCall LightState::toggle()
+{
+    auto call = make_call();
+    call.set_state(remote_values.get_state() == 0.0f);
+    return call;
+}
+
+inline LightCall LightState::turn_on()
+{
+    auto call = make_call();
+    call.set_state(true);
+    return call;
+}
+
+inline LightCall LightState::turn_off()
+{
+    auto call = make_call();
+    call.set_state(false);
+    return call;
+}
+
+} // namespace light
+} // namespace esphome
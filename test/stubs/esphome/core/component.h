@@ -0,0 +1,37 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "esphome/core/esphal.h"
+#include "esphome/core/log.h"
+
+// The Arduino core provides these in the global namespace.
+using std::max;
+using std::min;
+
+namespace esphome {
+
+namespace setup_priority {
+const float DATA = 600.0f;
+const float AFTER_WIFI = 200.0f;
+} // namespace setup_priority
+
+class Component
+{
+public:
+    virtual ~Component() = default;
+    virtual void setup() {}
+    virtual void loop() {}
+    virtual void dump_config() {}
+    virtual float get_setup_priority() const { return 0.0f; }
+
+    void mark_failed() { failed_ = true; }
+    bool is_failed() const { return failed_; }
+
+protected:
+    bool failed_ = false;
+};
+
+} // namespace esphome
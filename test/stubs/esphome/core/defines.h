@@ -0,0 +1,5 @@
+#pragma once
+
+// Generated by ESPHome from the configuration. The host tests use all
+// optional parts of the component.
+#define USE_YEELIGHT_BS2_FRONT_PANEL
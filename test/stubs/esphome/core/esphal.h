@@ -0,0 +1,63 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// Arduino time functions, based on the host's steady clock. A per-process
+// offset can be set, to simulate devices with unrelated clocks.
+namespace esphome_test {
+inline uint32_t &clock_offset()
+{
+    static uint32_t offset = 0;
+    return offset;
+}
+} // namespace esphome_test
+
+inline uint32_t micros()
+{
+    using namespace std::chrono;
+    auto now = duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+    return static_cast<uint32_t>(now) + esphome_test::clock_offset();
+}
+
+inline uint32_t millis()
+{
+    return micros() / 1000;
+}
+
+#define ICACHE_RAM_ATTR
+#define FALLING 0x02
+
+namespace esphome {
+
+/**
+ * A pin of which the interrupt is triggered by the test, using fire().
+ */
+class GPIOPin
+{
+public:
+    explicit GPIOPin(uint8_t pin = 16) : pin_(pin) {}
+
+    void setup() {}
+
+    uint8_t get_pin() const { return pin_; }
+
+    template<typename T> void attach_interrupt(void (*func)(T *), T *arg, int mode)
+    {
+        isr_ = reinterpret_cast<void (*)(void *)>(func);
+        arg_ = arg;
+    }
+
+    void fire()
+    {
+        if (isr_ != nullptr)
+            isr_(arg_);
+    }
+
+protected:
+    uint8_t pin_;
+    void (*isr_)(void *) = nullptr;
+    void *arg_ = nullptr;
+};
+
+} // namespace esphome
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+
+namespace esphome {
+
+inline uint32_t random_uint32()
+{
+    static std::mt19937 generator(getpid());
+    return generator();
+}
+
+template<typename... Ts> class CallbackManager;
+
+template<typename... Ts> class CallbackManager<void(Ts...)>
+{
+public:
+    void add(std::function<void(Ts...)> &&callback) { callbacks_.push_back(std::move(callback)); }
+
+    void call(Ts... args)
+    {
+        for (auto &callback : callbacks_)
+            callback(args...);
+    }
+
+protected:
+    std::vector<std::function<void(Ts...)>> callbacks_;
+};
+
+/**
+ * Same behavior as in ESPHome: while any requester is started, the
+ * application loop does not wait for the loop interval.
+ */
+class HighFrequencyLoopRequester
+{
+public:
+    void start()
+    {
+        if (started_)
+            return;
+        started_ = true;
+        requests()++;
+    }
+
+    void stop()
+    {
+        if (!started_)
+            return;
+        started_ = false;
+        requests()--;
+    }
+
+    static bool is_high_frequency() { return requests() > 0; }
+
+protected:
+    bool started_ = false;
+
+    static int &requests()
+    {
+        static int count = 0;
+        return count;
+    }
+};
+
+} // namespace esphome
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+
+// Log statements are not printed, but the arguments are still checked
+// against the format string. The number of log statements is counted, so
+// tests can check that hot paths do not log. When an expected tag is set,
+// log statements with a different tag are counted as well.
+namespace esphome_test {
+inline unsigned &log_count()
+{
+    static unsigned count = 0;
+    return count;
+}
+
+inline const char *&expected_log_tag()
+{
+    static const char *tag = nullptr;
+    return tag;
+}
+
+inline unsigned &unexpected_log_tags()
+{
+    static unsigned count = 0;
+    return count;
+}
+} // namespace esphome_test
+
+#define ESP_LOG_STUB_(tag, format, ...) \
+    do { \
+        esphome_test::log_count()++; \
+        if (esphome_test::expected_log_tag() != nullptr && strcmp(tag, esphome_test::expected_log_tag()) != 0) \
+            esphome_test::unexpected_log_tags()++; \
+        if (false) \
+            printf("%s" format, tag, ##__VA_ARGS__); \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) ESP_LOG_STUB_(tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_LOG_STUB_(tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_LOG_STUB_(tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ESP_LOG_STUB_(tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) ESP_LOG_STUB_(tag, format, ##__VA_ARGS__)
+#define ESP_LOGCONFIG(tag, format, ...) ESP_LOG_STUB_(tag, format, ##__VA_ARGS__)
@@ -0,0 +1,383 @@
+// Builds calibration images from the built-in tables, and loads them with
+// Calibration::map_file(). Checks that a mapped image produces the same LEDC
+// duties as the built-in tables, that a modified image is actually used and
+// that invalid images (including images with a valid checksum, but tables
+// that must not be used) fall back to the built-in tables. Reports the time
+// that each way of providing the tables adds to booting: the built-in
+// tables, the mapped image and an image that is copied or parsed into RAM.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+
+#include "test_helpers.h"
+#include "calibration.h"
+
+using namespace esphome;
+using namespace esphome::rgbww::yeelight_bs2;
+using esphome_test::TestLamp;
+
+static std::vector<std::string> temp_files;
+
+static std::string write_file(const void *data, size_t size)
+{
+    char path[] = "/tmp/test_calibration_XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0 && write(fd, data, size) == static_cast<ssize_t>(size));
+    close(fd);
+    temp_files.push_back(path);
+    return path;
+}
+
+static CalibrationTables builtin_tables()
+{
+    CalibrationTables tables;
+    tables.rgb_circle = rgb_circle_;
+    tables.rgbw_levels_1 = rgbw_levels_1_;
+    tables.rgbw_levels_100 = rgbw_levels_100_;
+    return tables;
+}
+
+/**
+ * Creates a calibration image file, like make_calibration.py does.
+ */
+static std::string write_image(const CalibrationTables &tables, uint16_t version = CALIBRATION_VERSION)
+{
+    std::vector<uint8_t> image(sizeof(CalibrationHeader) + sizeof(CalibrationTables));
+    CalibrationHeader header;
+    header.magic = CALIBRATION_MAGIC;
+    header.version = version;
+    header.header_size = sizeof(CalibrationHeader);
+    header.payload_size = sizeof(CalibrationTables);
+    header.crc32 = calibration_crc32(reinterpret_cast<const uint8_t *>(&tables), sizeof(tables));
+    memcpy(image.data(), &header, sizeof(header));
+    memcpy(image.data() + sizeof(header), &tables, sizeof(tables));
+    return write_file(image.data(), image.size());
+}
+
+/**
+ * Writes all table values as text, one per line, like a calibration that
+ * would be provided in a text format (e.g. the JSON from
+ * make_calibration.py) and parsed at boot time.
+ */
+static std::string write_text(const CalibrationTables &tables)
+{
+    std::string text;
+    auto values = reinterpret_cast<const float *>(&tables);
+    char line[32];
+    for (size_t i = 0; i < sizeof(tables) / sizeof(float); i++) {
+        snprintf(line, sizeof(line), "%.9g\n", values[i]);
+        text += line;
+    }
+    return write_file(text.data(), text.size());
+}
+
+static void set_values(TestLamp<> &lamp, bool white, float red, float green, float blue,
+                       float temperature, float brightness)
+{
+    light::LightColorValues values;
+    values.set_state(1.0f);
+    values.set_brightness(brightness);
+    values.set_white(white ? 1.0f : 0.0f);
+    values.set_red(red);
+    values.set_green(green);
+    values.set_blue(blue);
+    values.set_color_temperature(temperature);
+    lamp.state.current_values = values;
+    lamp.output.write_state(&lamp.state);
+}
+
+/**
+ * Writes a grid of RGB colors and white temperatures to both lamps, and
+ * returns the number of frames for which the duties differ.
+ */
+static int compare_lamps(TestLamp<> &lamp, TestLamp<> &reference)
+{
+    int differences = 0;
+    for (int r = 0; r <= 10; r++)
+        for (int g = 0; g <= 10; g++)
+            for (int b = 0; b <= 10; b++)
+                for (float brightness : { 0.01f, 0.3f, 0.77f, 1.0f }) {
+                    set_values(lamp, false, r / 10.0f, g / 10.0f, b / 10.0f, 0, brightness);
+                    set_values(reference, false, r / 10.0f, g / 10.0f, b / 10.0f, 0, brightness);
+                    differences += lamp.duties() != reference.duties();
+                }
+    for (int temperature = MIRED_MAX; temperature <= MIRED_MIN; temperature += 7)
+        for (float brightness : { 0.01f, 0.3f, 0.77f, 1.0f }) {
+            set_values(lamp, true, 1, 1, 1, temperature, brightness);
+            set_values(reference, true, 1, 1, 1, temperature, brightness);
+            differences += lamp.duties() != reference.duties();
+        }
+    return differences;
+}
+
+static void test_mapped_image()
+{
+    auto tables = builtin_tables();
+    auto path = write_image(tables);
+
+    Calibration calibration;
+    CHECK(calibration.map_file(path.c_str()));
+    CHECK(calibration.is_loaded() && calibration.get_error() == nullptr);
+    CHECK(static_cast<const void *>(calibration.rgb_circle) != static_cast<const void *>(&rgb_circle_));
+    CHECK(memcmp(calibration.rgb_circle, &rgb_circle_, sizeof(RGBCircle)) == 0);
+
+    TestLamp<> lamp;
+    TestLamp<> reference;
+    lamp.output.load_calibration(path.c_str());
+    auto differences = compare_lamps(lamp, reference);
+    printf("mapped image vs built-in tables: %d differing frames\n", differences);
+    CHECK(differences == 0);
+
+    // A modified image must actually be used: halve the white channel
+    // at full brightness.
+    for (auto &levels : tables.rgbw_levels_100)
+        levels.white /= 2;
+    TestLamp<> modified;
+    modified.output.load_calibration(write_image(tables).c_str());
+    set_values(modified, true, 1, 1, 1, 370, 1.0f);
+    set_values(reference, true, 1, 1, 1, 370, 1.0f);
+    CHECK(modified.white.get_duty() < reference.white.get_duty());
+    CHECK(modified.red.get_duty() == reference.red.get_duty());
+}
+
+static void test_invalid_images()
+{
+    auto tables = builtin_tables();
+    auto check_fallback = [](const std::string &path, const char *error) {
+        Calibration calibration;
+        CHECK(!calibration.map_file(path.c_str()));
+        CHECK(!calibration.is_loaded());
+        CHECK(calibration.get_error() != nullptr && strcmp(calibration.get_error(), error) == 0);
+        CHECK(calibration.rgb_circle == &rgb_circle_);
+        CHECK(calibration.rgbw_levels_1 == &rgbw_levels_1_ && calibration.rgbw_levels_100 == &rgbw_levels_100_);
+
+        TestLamp<> lamp;
+        TestLamp<> reference;
+        lamp.output.load_calibration(path.c_str());
+        CHECK(compare_lamps(lamp, reference) == 0);
+    };
+
+    check_fallback(write_image(tables, CALIBRATION_VERSION + 1), "unsupported calibration version");
+    check_fallback("/nonexistent/calibration.bin", "calibration file not found");
+
+    // A flipped bit in the payload.
+    auto path = write_image(tables);
+    int fd = open(path.c_str(), O_RDWR);
+    uint8_t byte;
+    CHECK(pread(fd, &byte, 1, 1000) == 1);
+    byte ^= 0x10;
+    CHECK(pwrite(fd, &byte, 1, 1000) == 1);
+    close(fd);
+    check_fallback(path, "calibration checksum mismatch");
+
+    // A truncated image.
+    std::vector<uint8_t> image(sizeof(CalibrationHeader) + sizeof(CalibrationTables) / 2);
+    fd = open(path.c_str(), O_RDONLY);
+    CHECK(read(fd, image.data(), image.size()) == static_cast<ssize_t>(image.size()));
+    close(fd);
+    check_fallback(write_file(image.data(), image.size()), "invalid calibration size");
+
+    // Not a calibration image at all.
+    memset(image.data(), 0xFF, image.size());
+    check_fallback(write_file(image.data(), image.size()), "no calibration image found");
+
+    // Valid checksums, but tables as they could result from editing the
+    // calibration by hand. The white light would throw for temperatures
+    // below the last row, and levels outside 0 - 1 must not reach the LEDs.
+    auto bad = builtin_tables();
+    bad.rgbw_levels_1.back().from_temperature = MIRED_MAX + 0.5f;
+    check_fallback(write_image(bad), "calibration temperatures do not cover the full range");
+    bad = builtin_tables();
+    std::swap(bad.rgbw_levels_100[3].from_temperature, bad.rgbw_levels_100[4].from_temperature);
+    check_fallback(write_image(bad), "calibration temperatures not descending");
+    bad = builtin_tables();
+    bad.rgbw_levels_100[5].from_temperature = bad.rgbw_levels_100[4].from_temperature;
+    check_fallback(write_image(bad), "calibration temperatures not descending");
+    bad = builtin_tables();
+    bad.rgbw_levels_1[0].from_temperature = NAN;
+    check_fallback(write_image(bad), "calibration temperatures not descending");
+    bad = builtin_tables();
+    bad.rgbw_levels_100[7].white = 1.5f;
+    check_fallback(write_image(bad), "calibration white level out of range");
+    bad = builtin_tables();
+    bad.rgbw_levels_1[2].red = -0.1f;
+    check_fallback(write_image(bad), "calibration white level out of range");
+    bad = builtin_tables();
+    bad.rgb_circle[3][17].high.green = NAN;
+    check_fallback(write_image(bad), "calibration RGB level out of range");
+    bad = builtin_tables();
+    bad.rgb_circle[6][23].low.blue = INFINITY;
+    check_fallback(write_image(bad), "calibration RGB level out of range");
+
+    // The extremes of the valid ranges are accepted.
+    bad = builtin_tables();
+    bad.rgb_circle[0][0].low.red = 0;
+    bad.rgb_circle[0][0].high.red = 1;
+    bad.rgbw_levels_1.back().from_temperature = 0;
+    Calibration calibration;
+    CHECK(calibration.map_file(write_image(bad).c_str()));
+}
+
+/**
+ * The ring level of (near) white colors is between ring 7 and the white
+ * center point, for which there is no ring in the color circle. These
+ * colors must use ring 7.
+ */
+static void test_white_center()
+{
+    auto check_ring_7 = [](float red, float green, float blue, size_t position) {
+        for (float brightness : { 0.01f, 0.5f, 1.0f }) {
+            RGBLight light;
+            light.set_color(red, green, blue, brightness, 1);
+            auto &point = rgb_circle_[6][position];
+            auto expected_red = point.low.red + (brightness - 0.01) * (point.high.red - point.low.red);
+            auto expected_green = point.low.green + (brightness - 0.01) * (point.high.green - point.low.green);
+            auto expected_blue = point.low.blue + (brightness - 0.01) * (point.high.blue - point.low.blue);
+            CHECK(std::isfinite(light.red) && std::isfinite(light.green) && std::isfinite(light.blue));
+            CHECK(fabs(light.red - (expected_red < 0.01 ? 0.0 : expected_red)) < 1e-5);
+            CHECK(fabs(light.green - expected_green) < 1e-5);
+            CHECK(fabs(light.blue - expected_blue) < 1e-5);
+        }
+    };
+    check_ring_7(1.0f, 1.0f, 1.0f, 0);
+    check_ring_7(0.9f, 0.9f, 1.0f, 16);
+    check_ring_7(0.95f, 1.0f, 1.0f, 12);
+
+    // Also with a mapped image, of which ring 7 is at the end of the
+    // color circle.
+    auto path = write_image(builtin_tables());
+    TestLamp<> lamp;
+    TestLamp<> reference;
+    lamp.output.load_calibration(path.c_str());
+    for (float level : { 0.86f, 0.9f, 0.95f, 0.99f, 1.0f }) {
+        set_values(lamp, false, level, 1.0f, level, 0, 0.8f);
+        set_values(reference, false, level, 1.0f, level, 0, 0.8f);
+        CHECK(lamp.duties() == reference.duties());
+        CHECK(lamp.green.get_duty() > 0 && lamp.green.get_duty() < 16384);
+    }
+}
+
+struct BootTime {
+    std::vector<double> load;
+    std::vector<double> first_frame;
+};
+
+static double elapsed_us(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Times providing the tables and computing the first RGB and white frame
+ * from them. The loader sets the table pointers to use, and returns
+ * whether loading succeeded.
+ */
+template<typename Loader> static void time_boot(BootTime &boot, Loader loader)
+{
+    RGBLight rgb;
+    WhiteLight white;
+    auto start = std::chrono::steady_clock::now();
+    CHECK(loader(rgb, white));
+    boot.load.push_back(elapsed_us(start));
+    start = std::chrono::steady_clock::now();
+    rgb.set_color(1.0f, 0.3f, 0.1f, 0.5f, 1);
+    white.set_color(370, 0.5f);
+    boot.first_frame.push_back(elapsed_us(start));
+}
+
+static double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+static void report(const char *label, const BootTime &boot, size_t ram)
+{
+    printf("  %-22s load %7.1f us, first frame %5.2f us, %4zu bytes RAM\n",
+           label, median(boot.load), median(boot.first_frame), ram);
+}
+
+static void test_boot_time()
+{
+    auto tables = builtin_tables();
+    auto image = write_image(tables);
+    auto text = write_text(tables);
+    const int runs = 300;
+    BootTime builtin, mapped, copied, parsed;
+
+    for (int i = 0; i < runs; i++) {
+        time_boot(builtin, [](RGBLight &rgb, WhiteLight &white) { return true; });
+
+        Calibration calibration;
+        time_boot(mapped, [&](RGBLight &rgb, WhiteLight &white) {
+            if (!calibration.map_file(image.c_str()))
+                return false;
+            rgb.set_rgb_circle(calibration.rgb_circle);
+            white.set_rgbw_levels(calibration.rgbw_levels_1, calibration.rgbw_levels_100);
+            return true;
+        });
+
+        // Read the image into RAM and validate it there.
+        std::vector<uint8_t> buffer;
+        Calibration copy;
+        time_boot(copied, [&](RGBLight &rgb, WhiteLight &white) {
+            buffer.resize(sizeof(CalibrationHeader) + sizeof(CalibrationTables));
+            int fd = open(image.c_str(), O_RDONLY);
+            auto size = read(fd, buffer.data(), buffer.size());
+            close(fd);
+            if (size != static_cast<ssize_t>(buffer.size()) || !copy.load(buffer.data(), buffer.size()))
+                return false;
+            rgb.set_rgb_circle(copy.rgb_circle);
+            white.set_rgbw_levels(copy.rgbw_levels_1, copy.rgbw_levels_100);
+            return true;
+        });
+
+        // Parse the values from text into RAM.
+        CalibrationTables parsed_tables;
+        time_boot(parsed, [&](RGBLight &rgb, WhiteLight &white) {
+            auto file = fopen(text.c_str(), "r");
+            if (file == nullptr)
+                return false;
+            auto values = reinterpret_cast<float *>(&parsed_tables);
+            char line[32];
+            size_t count = 0;
+            while (count < sizeof(parsed_tables) / sizeof(float) && fgets(line, sizeof(line), file) != nullptr)
+                values[count++] = strtof(line, nullptr);
+            fclose(file);
+            if (count != sizeof(parsed_tables) / sizeof(float))
+                return false;
+            rgb.set_rgb_circle(&parsed_tables.rgb_circle);
+            white.set_rgbw_levels(&parsed_tables.rgbw_levels_1, &parsed_tables.rgbw_levels_100);
+            return true;
+        });
+        CHECK(memcmp(&parsed_tables, &tables, sizeof(tables)) == 0);
+    }
+
+    printf("boot time, median of %d runs (%zu byte tables):\n", runs, sizeof(CalibrationTables));
+    report("built-in tables:", builtin, 0);
+    report("mapped image:", mapped, 0);
+    report("copied image:", copied, sizeof(CalibrationHeader) + sizeof(CalibrationTables));
+    report("parsed text:", parsed, sizeof(CalibrationTables));
+    // Mapping validates the image in place, which must be cheaper than
+    // parsing it. Copying is within the same range on the host, but
+    // needs the tables in RAM.
+    CHECK(median(mapped.load) < median(parsed.load));
+}
+
+int main()
+{
+    test_mapped_image();
+    test_invalid_images();
+    test_white_center();
+    test_boot_time();
+
+    for (auto &path : temp_files)
+        unlink(path.c_str());
+    return esphome_test::result();
+}
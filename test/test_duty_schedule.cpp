@@ -0,0 +1,175 @@
+// Checks that skipping frames in YeelightBS2LightOutput::write_state()
+// produces exactly the same LEDC duty ticks as computing every frame, and
+// reports how many frames were computed.
+
+#include <cstdlib>
+
+#include "test_helpers.h"
+
+using namespace esphome;
+using esphome_test::TestLamp;
+
+/**
+ * An output that computes every frame, used as the reference.
+ */
+class ReferenceOutput : public rgbww::YeelightBS2LightOutput
+{
+public:
+    void write_state(light::LightState *state) override
+    {
+        duty_schedule_.reset();
+        YeelightBS2LightOutput::write_state(state);
+    }
+};
+
+struct Fade {
+    bool white;
+    float red, green, blue, temperature;
+    float from, to;
+    int frames;
+    // For transitions between colors: the color at the end.
+    float to_red, to_green, to_blue, to_temperature;
+};
+
+struct FadeResult {
+    long frames = 0;
+    long computed = 0;
+    long mismatches = 0;
+    // Frames for which the duty ticks differ from the previous frame:
+    // the minimum number of frames that has to be computed.
+    long changes = 0;
+    unsigned log_lines = 0;
+};
+
+static float lerp(float from, float to, float progress)
+{
+    return from + progress * (to - from);
+}
+
+/**
+ * Runs a transition frame by frame, like LightState::loop() does, on an
+ * output with frame skipping and on the reference output.
+ */
+static FadeResult run_fade(const Fade &fade)
+{
+    TestLamp<> lamp;
+    TestLamp<ReferenceOutput> reference;
+    FadeResult result;
+
+    std::array<uint32_t, 4> previous {};
+    for (int i = 0; i <= fade.frames; i++) {
+        auto progress = float(i) / fade.frames;
+        light::LightColorValues values;
+        values.set_state(1.0f);
+        values.set_brightness(lerp(fade.from, fade.to, progress));
+        values.set_white(fade.white ? 1.0f : 0.0f);
+        if (fade.white) {
+            values.set_color_temperature(lerp(fade.temperature, fade.to_temperature, progress));
+        } else {
+            values.set_red(lerp(fade.red, fade.to_red, progress));
+            values.set_green(lerp(fade.green, fade.to_green, progress));
+            values.set_blue(lerp(fade.blue, fade.to_blue, progress));
+        }
+
+        lamp.state.current_values = values;
+        auto log_count = esphome_test::log_count();
+        lamp.output.write_state(&lamp.state);
+        result.log_lines += esphome_test::log_count() - log_count;
+        reference.state.current_values = values;
+        reference.output.write_state(&reference.state);
+
+        auto duties = lamp.duties();
+        auto expected = reference.duties();
+        for (size_t channel = 0; channel < 4; channel++)
+            if (duties[channel] != expected[channel])
+                result.mismatches++;
+        if (i == 0 || expected != previous)
+            result.changes++;
+        previous = expected;
+    }
+    result.frames = fade.frames + 1;
+    result.computed = lamp.output.get_frames_computed();
+    return result;
+}
+
+static Fade white_fade(float temperature, float from, float to, int frames)
+{
+    return { true, 1, 1, 1, temperature, from, to, frames, 1, 1, 1, temperature };
+}
+
+static Fade rgb_fade(float red, float green, float blue, float from, float to, int frames)
+{
+    return { false, red, green, blue, 0, from, to, frames, red, green, blue, 0 };
+}
+
+static FadeResult report(const char *name, const Fade &fade)
+{
+    auto result = run_fade(fade);
+    printf("%-34s %6ld frames, %6ld computed (%5.1f%%), %6ld tick changes, %ld mismatches\n",
+           name, result.frames, result.computed, 100.0 * result.computed / result.frames,
+           result.changes, result.mismatches);
+    CHECK(result.mismatches == 0);
+    return result;
+}
+
+static float random_float(float low, float high)
+{
+    return low + (high - low) * (rand() / float(RAND_MAX));
+}
+
+int main()
+{
+    // 30s transitions at ~1000 frames per second.
+    auto slow = report("white 2700K 50% -> 60%, 30s", white_fade(370, 0.5f, 0.6f, 30000));
+    CHECK(slow.computed * 4 < slow.frames);
+    // Skipped frames must not log: 3 lines per computed white frame.
+    CHECK(slow.log_lines == 3 * slow.computed);
+    report("white 4000K 1% -> 100%, 30s", white_fade(250, 0.01f, 1.0f, 30000));
+    report("white 6500K 100% -> 1%, 30s", white_fade(153, 1.0f, 0.01f, 30000));
+    auto rgb = report("rgb orange 2% -> 90%, 30s", rgb_fade(1.0f, 0.3f, 0.1f, 0.02f, 0.9f, 30000));
+    CHECK(rgb.computed < rgb.frames * 2 / 3);
+    report("rgb red 1% -> 100%, 30s", rgb_fade(1.0f, 0.0f, 0.0f, 0.01f, 1.0f, 30000));
+
+    // Cases that the first version of the schedule got wrong: the slope
+    // was determined from too small a brightness difference.
+    report("white 241 mired 83.68% -> 81.81%", white_fade(241, 0.8368f, 0.8181f, 12705));
+    report("rgb (0.187,0.664,1) 7.0% -> 9.9%", rgb_fade(0.187f, 0.664f, 1.0f, 0.070f, 0.099f, 41368));
+
+    // Fast transitions change the duty ticks on every frame.
+    auto fast = report("white 1% -> 100%, 20 frames", white_fade(370, 0.01f, 1.0f, 20));
+    CHECK(fast.computed == fast.frames);
+
+    // Transitions between colors cannot be skipped.
+    Fade color = rgb_fade(1.0f, 0.3f, 0.1f, 0.5f, 0.5f, 3000);
+    color.to_red = 0.1f;
+    color.to_green = 1.0f;
+    auto colors = report("rgb orange -> green, 3s", color);
+    CHECK(colors.computed == colors.frames);
+
+    // Random slow fades.
+    srand(26);
+    FadeResult total;
+    for (int i = 0; i < 400; i++) {
+        auto from = random_float(0.0f, 1.0f);
+        auto to = random_float(0.0f, 1.0f);
+        auto frames = 1000 + rand() % 50000;
+        Fade fade = i % 2 == 0 ?
+            white_fade(random_float(153, 588), from, to, frames) :
+            rgb_fade(random_float(0, 1), random_float(0, 1), random_float(0, 1), from, to, frames);
+        auto result = run_fade(fade);
+        if (result.mismatches > 0)
+            printf("mismatch: %s %.3f %.3f %.3f / %.0f mired, %.4f -> %.4f over %d frames\n",
+                   fade.white ? "white" : "rgb", fade.red, fade.green, fade.blue, fade.temperature,
+                   fade.from, fade.to, fade.frames);
+        total.frames += result.frames;
+        total.computed += result.computed;
+        total.mismatches += result.mismatches;
+        total.changes += result.changes;
+    }
+    printf("%-34s %6ld frames, %6ld computed (%5.1f%%), %6ld tick changes, %ld mismatches\n",
+           "400 random fades", total.frames, total.computed,
+           100.0 * total.computed / total.frames, total.changes, total.mismatches);
+    CHECK(total.mismatches == 0);
+
+    return esphome_test::result();
+}
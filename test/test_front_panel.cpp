@@ -0,0 +1,310 @@
+// Replays the I2C traces of the original firmware (in doc/reverse_engineering)
+// against the front panel component, within an emulated application loop.
+// Checks the light state after every panel event and the brightness
+// indicator commands, and reports the time from the panel interrupt up to
+// the first write of the new light state to the output. Also checks that
+// the configuration is logged under the tag of the front panel.
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+
+#include "test_helpers.h"
+#include "yeelight_front_panel.h"
+
+using namespace esphome;
+using namespace esphome::rgbww::yeelight_bs2;
+using esphome_test::TestApp;
+using esphome_test::TestLamp;
+
+static const char *TRACE_DIR = "../doc/reverse_engineering/I2C protocol/traces";
+
+struct Transaction {
+    bool read;
+    std::vector<uint8_t> bytes;
+};
+
+/**
+ * Parses a trace as exported from the logic analyzer. Data bytes are
+ * either on separate "Data read: XX" / "Data write: XX" lines, or
+ * (in edited traces) on a single line of hex bytes.
+ */
+static std::vector<Transaction> parse_trace(const std::string &path)
+{
+    std::vector<Transaction> transactions;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.find("Address read: 2C") != std::string::npos) {
+            transactions.push_back({ true, {} });
+        } else if (line.find("Address write: 2C") != std::string::npos) {
+            transactions.push_back({ false, {} });
+        } else if (transactions.empty()) {
+            continue;
+        } else if (line.find("Data read: ") != std::string::npos ||
+                   line.find("Data write: ") != std::string::npos) {
+            transactions.back().bytes.push_back(std::stoi(line.substr(line.rfind(' ') + 1), nullptr, 16));
+        } else if (line.size() >= 2 && isxdigit(line[0]) && isxdigit(line[1]) &&
+                   (line.size() == 2 || line[2] == ' ')) {
+            for (size_t i = 0; i + 1 < line.size(); i += 3)
+                transactions.back().bytes.push_back(std::stoi(line.substr(i, 2), nullptr, 16));
+        }
+    }
+    return transactions;
+}
+
+static std::vector<std::string> list_traces()
+{
+    std::vector<std::string> names;
+    auto dir = opendir(TRACE_DIR);
+    if (dir == nullptr)
+        return names;
+    while (auto entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.size() > 4 && name.substr(name.size() - 4) == ".txt")
+            names.push_back(name);
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+static bool is_indicator_command(const std::vector<uint8_t> &bytes)
+{
+    return bytes.size() == 7 && bytes[0] == 0x02 && bytes[1] == 0x03;
+}
+
+static std::vector<uint8_t> to_vector(const PanelCommand &command)
+{
+    return std::vector<uint8_t>(command.begin(), command.end());
+}
+
+struct Panel {
+    TestLamp<> lamp;
+    GPIOPin trigger_pin;
+    rgbww::YeelightFrontPanel panel;
+    TestApp app {&lamp.state, &panel};
+    bool performed = false;
+    bool written = false;
+    uint32_t perform_time = 0;
+    uint32_t write_time = 0;
+
+    Panel()
+    {
+        panel.set_light_state(&lamp.state);
+        panel.set_output(&lamp.output);
+        panel.set_trigger_pin(&trigger_pin);
+        app.setup();
+        lamp.state.add_new_remote_values_callback([this]() {
+            performed = true;
+            perform_time = micros();
+        });
+        lamp.output.add_on_state_written_callback([this]() {
+            if (performed && !written) {
+                written = true;
+                write_time = micros();
+            }
+        });
+    }
+};
+
+/**
+ * The indicator commands as written by the original firmware must be
+ * commands that encode_panel_level() produces. For the traces of remote
+ * brightness changes, the last command must match what the component
+ * writes for the target brightness.
+ */
+static void test_indicator_commands(const std::vector<std::string> &traces)
+{
+    int commands = 0;
+    int remote_traces = 0;
+    for (auto &name : traces) {
+        std::vector<uint8_t> last;
+        for (auto &transaction : parse_trace(std::string(TRACE_DIR) + "/" + name)) {
+            if (transaction.read || !is_indicator_command(transaction.bytes))
+                continue;
+            bool known = transaction.bytes == to_vector(PANEL_TURN_OFF);
+            for (uint8_t level = 1; level <= PANEL_LEVELS; level++)
+                known = known || transaction.bytes == to_vector(encode_panel_level(level));
+            CHECK(known);
+            commands++;
+            last = transaction.bytes;
+        }
+
+        int from, to;
+        if (sscanf(name.c_str(), "remote %d%% to %d%%", &from, &to) == 2) {
+            Panel panel;
+            auto call = panel.lamp.state.make_call();
+            call.set_state(true);
+            call.set_brightness(to / 100.0f);
+            call.perform();
+            if (panel.panel.writes.empty() || panel.panel.writes.back() != last)
+                printf("%s: indicator command differs from the original firmware\n", name.c_str());
+            CHECK(!panel.panel.writes.empty() && panel.panel.writes.back() == last);
+            remote_traces++;
+        } else if (name == "remote off.txt") {
+            Panel panel;
+            panel.lamp.state.turn_on().perform();
+            panel.lamp.state.turn_off().perform();
+            CHECK(panel.panel.writes.back() == last);
+            remote_traces++;
+        }
+    }
+    printf("indicator commands: %d from the traces, %d remote traces matched\n", commands, remote_traces);
+    CHECK(commands > 0 && remote_traces == 7);
+}
+
+struct Latencies {
+    std::vector<uint32_t> total;
+    std::vector<uint32_t> to_perform;
+    std::vector<uint32_t> to_write;
+};
+
+/**
+ * Replays the panel events of a trace, and checks the light state after
+ * each of them. Like the real interrupt, the event is signaled at a random
+ * point in time, while the application loop keeps running.
+ */
+static int replay_events(const std::string &name, Latencies &latencies)
+{
+    Panel panel;
+    auto &state = panel.lamp.state;
+    size_t preset = 0;
+    int events = 0;
+    for (auto &transaction : parse_trace(std::string(TRACE_DIR) + "/" + name)) {
+        if (!transaction.read || transaction.bytes.size() != 7)
+            continue;
+        auto event = decode_panel_event(transaction.bytes.data());
+        CHECK(event.type != PANEL_EVENT_NONE);
+        events++;
+
+        auto before = state.remote_values;
+        std::copy(transaction.bytes.begin(), transaction.bytes.end(), panel.panel.next_read.begin());
+        panel.performed = false;
+        panel.written = false;
+        auto reads = panel.panel.writes.size();
+
+        std::atomic<bool> fired(false);
+        uint32_t start = 0;
+        std::thread trigger([&]() {
+            usleep(esphome::random_uint32() % TestApp::LOOP_INTERVAL);
+            start = micros();
+            panel.trigger_pin.fire();
+            fired = true;
+        });
+        for (int i = 0; i < 100 && (!fired || panel.panel.writes.size() == reads ||
+                                    (panel.performed && !panel.written)); i++)
+            panel.app.loop();
+        trigger.join();
+
+        auto values = state.remote_values;
+        switch (event.type) {
+        case PANEL_EVENT_POWER_TOUCH:
+            CHECK(values.get_state() != before.get_state());
+            break;
+        case PANEL_EVENT_COLOR_TOUCH: {
+            preset = (preset + 1) % panel_color_presets_.size();
+            auto &expected = panel_color_presets_[preset];
+            CHECK(values.get_state() == 1);
+            CHECK((values.get_white() == 1) == expected.white);
+            if (expected.white)
+                CHECK(values.get_color_temperature() == expected.temperature);
+            else
+                CHECK(values.get_red() == expected.red && values.get_green() == expected.green &&
+                      values.get_blue() == expected.blue);
+            break;
+        }
+        case PANEL_EVENT_SLIDER_TOUCH:
+        case PANEL_EVENT_SLIDER_RELEASE:
+            CHECK(values.get_state() == 1);
+            CHECK(fabsf(values.get_brightness() - (0.01f + 0.99f * (event.level - 1) / (SLIDER_LEVELS - 1))) < 1e-6f);
+            break;
+        default:
+            CHECK(!panel.performed);
+            continue;
+        }
+
+        CHECK(panel.written);
+        if (!panel.written)
+            continue;
+        // The component takes its timestamps a few microseconds after the
+        // test does.
+        auto latency = panel.write_time - start;
+        CHECK(panel.panel.get_last_latency() <= latency && panel.panel.get_last_latency() + 100 > latency);
+        latencies.total.push_back(panel.write_time - start);
+        latencies.to_perform.push_back(panel.perform_time - start);
+        latencies.to_write.push_back(panel.write_time - panel.perform_time);
+    }
+
+    if (events == 0)
+        return 0;
+
+    // The indicator follows the brightness.
+    auto values = state.remote_values;
+    auto expected = values.get_state() == 0 ? PANEL_TURN_OFF :
+        encode_panel_level(static_cast<uint8_t>(values.get_brightness() * PANEL_LEVELS + 0.5f));
+    std::vector<std::vector<uint8_t>> indicator;
+    for (auto &command : panel.panel.writes)
+        if (is_indicator_command(command))
+            indicator.push_back(command);
+    CHECK(!indicator.empty() && indicator.back() == to_vector(expected));
+    return events;
+}
+
+static void test_dump_config()
+{
+    Panel panel;
+    auto count = esphome_test::log_count();
+    esphome_test::expected_log_tag() = rgbww::TAG_PANEL;
+    panel.panel.dump_config();
+    esphome_test::expected_log_tag() = nullptr;
+    CHECK(esphome_test::log_count() - count == 4);
+    CHECK(esphome_test::unexpected_log_tags() == 0);
+}
+
+static void report(const char *label, std::vector<uint32_t> values)
+{
+    std::sort(values.begin(), values.end());
+    uint64_t total = 0;
+    for (auto value : values)
+        total += value;
+    printf("  %-26s mean %5llu us, median %5u us, max %5u us\n", label,
+           static_cast<unsigned long long>(total / values.size()), values[values.size() / 2], values.back());
+}
+
+int main()
+{
+    auto traces = list_traces();
+    CHECK(traces.size() >= 10);
+    if (esphome_test::failures() > 0)
+        return esphome_test::result();
+
+    test_dump_config();
+    test_indicator_commands(traces);
+
+    Latencies latencies;
+    int events = 0;
+    for (auto &name : traces)
+        events += replay_events(name, latencies);
+    printf("replayed %d panel events, %zu light calls\n", events, latencies.total.size());
+    CHECK(latencies.total.size() > 30);
+    report("interrupt to light call:", latencies.to_perform);
+    report("light call to first write:", latencies.to_write);
+    report("interrupt to first write:", latencies.total);
+
+    // The wait for the panel's loop is up to one loop interval. After the
+    // light call, the first write follows without waiting again.
+    std::sort(latencies.to_write.begin(), latencies.to_write.end());
+    CHECK(latencies.to_write[latencies.to_write.size() / 2] < TestApp::LOOP_INTERVAL / 4);
+    std::sort(latencies.total.begin(), latencies.total.end());
+    CHECK(latencies.total[latencies.total.size() / 2] < TestApp::LOOP_INTERVAL + TestApp::LOOP_INTERVAL / 4);
+
+    return esphome_test::result();
+}
@@ -0,0 +1,223 @@
+// Runs a group of lamps as separate processes, each with its own clock
+// offset and an emulated application loop, exchanging group sync messages
+// over loopback UDP broadcast. Reports how far apart (in real time) the
+// lamps perform the light call and write the first frame for each scene.
+// Also checks that out of range scene values are clamped the same way on
+// the leader and on a follower.
+//
+// The lamps run a high frequency loop while timing matters, so on a
+// single CPU they compete with anything else that runs at the same time.
+// The spread is therefore checked for the median scene, which keeps a
+// margin against a few scenes that are disturbed by other processes.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <sys/wait.h>
+
+#include "test_helpers.h"
+#include "yeelight_group_sync.h"
+
+using namespace esphome;
+using esphome_test::TestApp;
+using esphome_test::TestLamp;
+
+static const uint16_t TEST_PORT = 55450;
+static const char *BROADCAST_ADDRESS = "127.255.255.255";
+static const int LAMPS = 4;
+static const int SCENES = 6;
+
+// Time on the host clock, which is shared by all processes.
+static int64_t true_micros()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+struct SceneTimes {
+    int64_t perform[SCENES + 1];
+    int64_t first_write[SCENES + 1];
+};
+
+static int run_lamp(int index, int output_fd)
+{
+    bool leader = index == 0;
+    esphome_test::clock_offset() = index * 123456789u;
+
+    TestLamp<> lamp;
+    rgbww::YeelightGroupSync sync;
+    sync.set_light_state(&lamp.state);
+    sync.set_leader(leader);
+    sync.set_group(3);
+    sync.set_port(TEST_PORT);
+    sync.set_broadcast_address(BROADCAST_ADDRESS);
+    sync.set_sync_interval(200);
+    sync.set_lead_time(150);
+    TestApp app {&lamp.state, &sync};
+    app.setup();
+    if (sync.is_failed())
+        return 2;
+
+    // Every lamp performs one light call per scene, in order.
+    SceneTimes times;
+    memset(&times, 0, sizeof(times));
+    int performed = 0;
+    lamp.state.add_new_remote_values_callback([&]() {
+        if (++performed <= SCENES)
+            times.perform[performed] = true_micros();
+    });
+    lamp.output.add_on_state_written_callback([&]() {
+        if (performed > 0 && performed <= SCENES && times.first_write[performed] == 0)
+            times.first_write[performed] = true_micros();
+    });
+
+    // Sync the clocks, then start a scene every 400ms. Lamp 1 requests
+    // one of them, to also cover scene requests to the leader.
+    auto start = true_micros();
+    int requested = 0;
+    while (true_micros() - start < 1000000 + SCENES * 400000 + 500000) {
+        app.loop();
+        auto elapsed = true_micros() - start;
+        if (requested < SCENES && elapsed >= 1000000 + requested * 400000) {
+            bool requester = requested == 2 ? index == 1 : leader;
+            if (requester)
+                sync.start_rgb_transition(requested % 2, 0.5f, 1, 0.2f + 0.1f * requested, 1000);
+            requested++;
+        }
+    }
+
+    if (leader) {
+        for (size_t i = 0; i < rgbww::SYNC_MAX_LAMPS; i++) {
+            auto &skew = sync.get_lamp_skews()[i];
+            if (skew.lamp_id != 0)
+                printf("lamp %08x reported: scene %u, skew %d us, clock offset error <= %u us\n",
+                       skew.lamp_id, skew.scene, skew.skew, skew.rtt / 2);
+        }
+        fflush(stdout);
+    }
+    if (write(output_fd, &times, sizeof(times)) != sizeof(times))
+        return 3;
+    return 0;
+}
+
+static bool near(float value, float expected) { return fabsf(value - expected) < 1e-3f; }
+
+/**
+ * A leader and a follower in a single process. Scenes with values outside
+ * the supported ranges (as easily passed from a Home Assistant service)
+ * must result in the same, clamped light state on both lamps.
+ */
+static void test_clamping()
+{
+    TestLamp<> leader_lamp;
+    TestLamp<> follower_lamp;
+    rgbww::YeelightGroupSync leader;
+    rgbww::YeelightGroupSync follower;
+    for (auto sync : { &leader, &follower }) {
+        sync->set_group(4);
+        sync->set_port(TEST_PORT + 1);
+        sync->set_broadcast_address(BROADCAST_ADDRESS);
+        sync->set_sync_interval(50);
+        sync->set_lead_time(20);
+    }
+    leader.set_light_state(&leader_lamp.state);
+    leader.set_leader(true);
+    follower.set_light_state(&follower_lamp.state);
+    TestApp app {&leader_lamp.state, &follower_lamp.state, &leader, &follower};
+    app.setup();
+    CHECK(!leader.is_failed() && !follower.is_failed());
+
+    auto start = millis();
+    while (!follower.has_clock_offset() && millis() - start < 2000)
+        app.loop();
+    CHECK(follower.has_clock_offset());
+
+    int performed = 0;
+    leader_lamp.state.add_new_remote_values_callback([&]() { performed++; });
+    follower_lamp.state.add_new_remote_values_callback([&]() { performed++; });
+    auto run_scene = [&]() {
+        performed = 0;
+        auto start = millis();
+        while (performed < 2 && millis() - start < 1000)
+            app.loop();
+        CHECK(performed == 2);
+    };
+
+    // Colors and brightness in 0 - 255, as well as negative and NaN values.
+    follower.start_rgb_transition(200, -1, NAN, 128, 0);
+    run_scene();
+    for (auto lamp : { &leader_lamp, &follower_lamp }) {
+        auto &values = lamp->state.remote_values;
+        CHECK(values.get_state() == 1 && values.get_white() == 0);
+        CHECK(values.get_red() == 1 && values.get_green() == 0 && values.get_blue() == 0);
+        CHECK(values.get_brightness() == 1);
+    }
+
+    // A color temperature in Kelvin instead of mireds.
+    leader.start_white_transition(2700, 0.5f, 0);
+    run_scene();
+    for (auto lamp : { &leader_lamp, &follower_lamp }) {
+        auto &values = lamp->state.remote_values;
+        CHECK(values.get_white() == 1 && values.get_color_temperature() == rgbww::yeelight_bs2::MIRED_MIN);
+        CHECK(near(values.get_brightness(), 0.5f));
+    }
+}
+
+static int64_t spread(const std::vector<int64_t> &values)
+{
+    return *std::max_element(values.begin(), values.end()) - *std::min_element(values.begin(), values.end());
+}
+
+int main()
+{
+    int pipes[LAMPS][2];
+    for (int i = 0; i < LAMPS; i++) {
+        if (pipe(pipes[i]) < 0)
+            return 1;
+        if (fork() == 0) {
+            close(pipes[i][0]);
+            _exit(run_lamp(i, pipes[i][1]));
+        }
+        close(pipes[i][1]);
+    }
+
+    SceneTimes times[LAMPS];
+    for (int i = 0; i < LAMPS; i++) {
+        int status;
+        wait(&status);
+        CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    for (int i = 0; i < LAMPS; i++)
+        CHECK(read(pipes[i][0], &times[i], sizeof(SceneTimes)) == sizeof(SceneTimes));
+    if (esphome_test::failures() > 0)
+        return esphome_test::result();
+
+    std::vector<int64_t> perform_spreads, write_spreads;
+    for (int scene = 1; scene <= SCENES; scene++) {
+        std::vector<int64_t> perform, first_write;
+        for (int i = 0; i < LAMPS; i++) {
+            CHECK(times[i].perform[scene] != 0 && times[i].first_write[scene] != 0);
+            perform.push_back(times[i].perform[scene]);
+            first_write.push_back(times[i].first_write[scene]);
+        }
+        printf("scene %d: perform spread %lld us, first write spread %lld us\n",
+               scene, static_cast<long long>(spread(perform)), static_cast<long long>(spread(first_write)));
+        perform_spreads.push_back(spread(perform));
+        write_spreads.push_back(spread(first_write));
+    }
+    // Without the high frequency loop, the spread is up to two loop
+    // intervals (one for the start, one for the first write): typically
+    // 10 - 16ms. On a quiet machine, it is below 0.2ms.
+    std::sort(perform_spreads.begin(), perform_spreads.end());
+    std::sort(write_spreads.begin(), write_spreads.end());
+    printf("median spread: perform %lld us, first write %lld us\n",
+           static_cast<long long>(perform_spreads[SCENES / 2]), static_cast<long long>(write_spreads[SCENES / 2]));
+    CHECK(perform_spreads[SCENES / 2] < TestApp::LOOP_INTERVAL / 4);
+    CHECK(write_spreads[SCENES / 2] < TestApp::LOOP_INTERVAL / 4);
+
+    test_clamping();
+
+    return esphome_test::result();
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <array>
+#include <cstdio>
+#include <initializer_list>
+#include <vector>
+#include <sched.h>
+#include <unistd.h>
+
+#include "esphome/core/component.h"
+#include "esphome/core/helpers.h"
+#include "esphome/components/light/light_state.h"
+#include "night_light.h"
+#include "yeelight_bs2_light_output.h"
+
+namespace esphome_test {
+
+inline int &failures()
+{
+    static int count = 0;
+    return count;
+}
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            esphome_test::failures()++; \
+        } \
+    } while (0)
+
+inline int result()
+{
+    if (failures() == 0)
+        printf("OK\n");
+    else
+        printf("FAILED (%d checks)\n", failures());
+    return failures() == 0 ? 0 : 1;
+}
+
+/**
+ * A YeelightBS2LightOutput, wired up to LEDC and GPIO outputs that record
+ * what is written to them, plus the light state that drives it.
+ */
+template<typename Output = esphome::rgbww::YeelightBS2LightOutput>
+struct TestLamp {
+    esphome::ledc::LEDCOutput red;
+    esphome::ledc::LEDCOutput green;
+    esphome::ledc::LEDCOutput blue;
+    esphome::ledc::LEDCOutput white;
+    esphome::gpio::GPIOBinaryOutput master1;
+    esphome::gpio::GPIOBinaryOutput master2;
+    Output output;
+    esphome::light::LightState state {&output};
+
+    TestLamp()
+    {
+        output.set_red_output(&red);
+        output.set_green_output(&green);
+        output.set_blue_output(&blue);
+        output.set_white_output(&white);
+        output.set_master1_output(&master1);
+        output.set_master2_output(&master2);
+    }
+
+    std::array<uint32_t, 4> duties() const
+    {
+        return {{ red.get_duty(), green.get_duty(), blue.get_duty(), white.get_duty() }};
+    }
+};
+
+/**
+ * Runs components like the ESPHome application loop does: every loop
+ * iteration calls the components in order of setup priority, and then
+ * waits for the remainder of the loop interval (16ms), unless a high
+ * frequency loop is requested.
+ */
+class TestApp
+{
+public:
+    static const uint32_t LOOP_INTERVAL = 16000;
+
+    TestApp(std::initializer_list<esphome::Component *> components) : components_(components) {}
+
+    void setup()
+    {
+        for (auto component : components_)
+            component->setup();
+        last_loop_ = micros();
+    }
+
+    void loop()
+    {
+        for (auto component : components_)
+            component->loop();
+        iterations_++;
+        if (esphome::HighFrequencyLoopRequester::is_high_frequency()) {
+            // Like yield() on the device: let other processes (lamps) run.
+            sched_yield();
+        } else {
+            auto elapsed = micros() - last_loop_;
+            if (elapsed < LOOP_INTERVAL)
+                usleep(LOOP_INTERVAL - elapsed);
+        }
+        last_loop_ = micros();
+    }
+
+    uint32_t get_iterations() const { return iterations_; }
+
+protected:
+    std::vector<esphome::Component *> components_;
+    uint32_t last_loop_ = 0;
+    uint32_t iterations_ = 0;
+};
+
+} // namespace esphome_test
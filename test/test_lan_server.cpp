@@ -0,0 +1,445 @@
+// Runs the LAN protocol server against a client over a loopback TCP
+// connection, within an emulated application loop. Checks the parser, the
+// replies and resulting light state for every supported method (including
+// color flows and numbers that do not fit in a long), and reports the
+// command throughput and the command-to-duty latency.
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "test_helpers.h"
+#include "yeelight_lan_server.h"
+
+using namespace esphome;
+using esphome_test::TestApp;
+using esphome_test::TestLamp;
+
+static const uint16_t TEST_PORT = 55999;
+
+struct Client {
+    int fd = -1;
+    std::string received;
+
+    bool connect_to(uint16_t port)
+    {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        if (connect(fd, (struct sockaddr *) &address, sizeof(address)) < 0)
+            return false;
+        int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        return true;
+    }
+
+    void send_line(const std::string &line)
+    {
+        auto data = line + "\r\n";
+        send(fd, data.data(), data.size(), 0);
+    }
+
+    void poll()
+    {
+        char buffer[4096];
+        ssize_t len;
+        while ((len = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+            received.append(buffer, len);
+    }
+
+    /**
+     * Takes the received reply lines, without line endings.
+     */
+    std::vector<std::string> take_replies()
+    {
+        poll();
+        std::vector<std::string> replies;
+        size_t end;
+        while ((end = received.find("\r\n")) != std::string::npos) {
+            replies.push_back(received.substr(0, end));
+            received.erase(0, end + 2);
+        }
+        return replies;
+    }
+};
+
+static std::vector<std::string> run_until_replies(TestApp &app, Client &client, size_t count)
+{
+    std::vector<std::string> replies;
+    for (int i = 0; i < 1000 && replies.size() < count; i++) {
+        app.loop();
+        auto more = client.take_replies();
+        replies.insert(replies.end(), more.begin(), more.end());
+    }
+    return replies;
+}
+
+static std::string set_bright(long id, int bright)
+{
+    return "{\"id\":" + std::to_string(id) + ",\"method\":\"set_bright\",\"params\":[" +
+        std::to_string(bright) + ",\"sudden\",0]}";
+}
+
+/**
+ * Sends a single command, and returns its reply.
+ */
+static std::string command(TestApp &app, Client &client, const std::string &json)
+{
+    client.send_line(json);
+    auto replies = run_until_replies(app, client, 1);
+    CHECK(replies.size() == 1);
+    return replies.empty() ? "" : replies[0];
+}
+
+static std::string ok(long id)
+{
+    return "{\"id\":" + std::to_string(id) + ",\"result\":[\"ok\"]}";
+}
+
+static std::string error(long id, const char *message)
+{
+    return "{\"id\":" + std::to_string(id) + ",\"error\":{\"code\":-1,\"message\":\"" + message + "\"}}";
+}
+
+static bool near(float value, float expected) { return fabsf(value - expected) < 1e-4f; }
+
+static bool has_rgb(const light::LightColorValues &values, float red, float green, float blue)
+{
+    return values.get_white() == 0 && near(values.get_red(), red) && near(values.get_green(), green) &&
+        near(values.get_blue(), blue);
+}
+
+static bool has_ct(const light::LightColorValues &values, float mireds)
+{
+    return values.get_white() == 1 && near(values.get_color_temperature(), mireds);
+}
+
+static bool parses(const char *json, rgbww::yeelight_bs2::LanCommand &command)
+{
+    rgbww::yeelight_bs2::LanCommandParser parser;
+    return parser.parse(json, strlen(json), command);
+}
+
+static void test_parser()
+{
+    rgbww::yeelight_bs2::LanCommand command;
+
+    // Whitespace between all tokens, and unknown keys with nested values.
+    CHECK(parses(" {\t\"id\" : 3 ,\r\n \"x\" : {\"a\":[1,{\"b\":null},true]} ,"
+                 " \"method\" : \"set_bright\" , \"params\" : [ 20 , \"sudden\" , 0 ] } ", command));
+    CHECK(command.has_id && command.id == 3 && command.is_method("set_bright"));
+    CHECK(command.param_count == 3 && command.number_param(0, -1) == 20 && command.params[1].is_string("sudden"));
+
+    // Nested parameters are skipped, but keep their position.
+    CHECK(parses("{\"id\":1,\"method\":\"m\",\"params\":[[1,[2,[3]]],{\"k\":\"v\"},7]}", command));
+    CHECK(command.param_count == 3 && command.params[0].type == rgbww::yeelight_bs2::LanValue::OTHER &&
+          command.params[1].type == rgbww::yeelight_bs2::LanValue::OTHER && command.number_param(2, -1) == 7);
+
+    // Escaped characters are kept as is, and do not end the string.
+    CHECK(parses("{\"id\":1,\"method\":\"m\",\"params\":[\"a\\\"b\\\\\",\"c\"]}", command));
+    CHECK(command.param_count == 2 && command.params[0].len == 6 && strncmp(command.params[0].str, "a\\\"b\\\\", 6) == 0);
+    CHECK(command.params[1].is_string("c"));
+
+    // Fractions and exponents are truncated.
+    CHECK(parses("{\"id\":1,\"method\":\"m\",\"params\":[50.75,-2.5e+3,7E2]}", command));
+    CHECK(command.number_param(0, 0) == 50 && command.number_param(1, 0) == -2 && command.number_param(2, 0) == 7);
+
+    // Invalid JSON.
+    const char *invalid[] = {
+        "{\"id\":1,\"method\":\"m\",\"params\":[50-3]}",
+        "{\"id\":1,\"method\":\"m\",\"params\":[5e]}",
+        "{\"id\":1,\"method\":\"m\",\"params\":[5e+]}",
+        "{\"id\":1,\"method\":\"m\",\"params\":[50.]}",
+        "{\"id\":1,\"method\":\"m\",\"params\":[.5]}",
+        "{\"id\":1,\"method\":\"m\",\"params\":[5.5.5]}",
+        "{\"id\":1,\"method\":\"m\",\"params\":[-]}",
+        "{\"id\":1,\"method\":\"m\",\"params\":[1 2]}",
+        "{\"id\":1,\"method\":\"m\",\"params\":[\"open]}",
+        "{\"id\":1,\"method\":\"m\",\"params\":[[[[[[[[[[[1]]]]]]]]]]]}",
+        "{\"id\":1,\"method\":\"m\"} trailing",
+    };
+    for (auto json : invalid) {
+        if (parses(json, command))
+            printf("accepted invalid JSON: %s\n", json);
+        CHECK(!parses(json, command));
+    }
+}
+
+/**
+ * The color and temperature methods: replies, and the resulting light
+ * state and duties.
+ */
+static void test_methods(TestApp &app, Client &client, TestLamp<> &lamp)
+{
+    auto &values = lamp.state.remote_values;
+
+    CHECK(command(app, client, "{\"id\":10,\"method\":\"set_rgb\",\"params\":[16711680,\"smooth\",300]}") == ok(10));
+    CHECK(has_rgb(values, 1, 0, 0) && lamp.state.is_transitioning());
+    CHECK(command(app, client, "{\"id\":11,\"method\":\"get_prop\",\"params\":[\"rgb\",\"color_mode\",\"x\"]}") ==
+          "{\"id\":11,\"result\":[\"16711680\",\"1\",\"\"]}");
+    for (int i = 0; i < 40 && lamp.state.is_transitioning(); i++)
+        app.loop();
+    CHECK(!lamp.state.is_transitioning());
+    CHECK(lamp.red.get_duty() < lamp.green.get_duty() && lamp.white.get_duty() == 0);
+
+    CHECK(command(app, client, "{\"id\":12,\"method\":\"set_hsv\",\"params\":[240,100,\"sudden\",0]}") == ok(12));
+    CHECK(has_rgb(values, 0, 0, 1) && !lamp.state.is_transitioning());
+    CHECK(command(app, client, "{\"id\":13,\"method\":\"set_hsv\",\"params\":[120,50]}") == ok(13));
+    CHECK(has_rgb(values, 0.5f, 1, 0.5f));
+    CHECK(command(app, client, "{\"id\":14,\"method\":\"get_prop\",\"params\":[\"rgb\"]}") ==
+          "{\"id\":14,\"result\":[\"8454016\"]}");
+
+    CHECK(command(app, client, "{\"id\":15,\"method\":\"set_ct_abx\",\"params\":[2700,\"sudden\",0]}") == ok(15));
+    CHECK(has_ct(values, 1000000.0f / 2700));
+    app.loop();
+    CHECK(lamp.white.get_duty() > 0);
+    CHECK(command(app, client, "{\"id\":16,\"method\":\"get_prop\",\"params\":[\"ct\",\"color_mode\"]}") ==
+          "{\"id\":16,\"result\":[\"2700\",\"2\"]}");
+
+    // Out of range parameters do not change the light state.
+    auto before = values;
+    const char *invalid[] = {
+        "{\"id\":17,\"method\":\"set_rgb\",\"params\":[16777216,\"sudden\",0]}",
+        "{\"id\":17,\"method\":\"set_rgb\",\"params\":[\"red\"]}",
+        "{\"id\":17,\"method\":\"set_hsv\",\"params\":[360,50]}",
+        "{\"id\":17,\"method\":\"set_hsv\",\"params\":[120,101]}",
+        "{\"id\":17,\"method\":\"set_ct_abx\",\"params\":[1699]}",
+        "{\"id\":17,\"method\":\"set_ct_abx\",\"params\":[6501]}",
+        "{\"id\":17,\"method\":\"set_power\",\"params\":[\"maybe\"]}",
+    };
+    for (auto json : invalid)
+        CHECK(command(app, client, json) == error(17, "invalid params"));
+    CHECK(command(app, client, "{\"id\":18,\"method\":\"set_music\",\"params\":[1]}") ==
+          error(18, "method not supported"));
+    CHECK(has_ct(values, before.get_color_temperature()) && values.get_brightness() == before.get_brightness());
+
+    // Power on in night light mode.
+    CHECK(command(app, client, "{\"id\":19,\"method\":\"set_power\",\"params\":[\"on\",\"sudden\",0,5]}") == ok(19));
+    CHECK(has_rgb(values, 1, 1, 1) && near(values.get_brightness(), 0.01f));
+}
+
+// The light calls that were performed, as recorded by test_flows().
+static std::vector<light::LightColorValues> calls;
+
+/**
+ * Runs a color flow with a finite count up to its end, and returns the
+ * light calls that it made.
+ */
+static std::vector<light::LightColorValues> run_flow(TestApp &app, Client &client, TestLamp<> &lamp,
+                                                     long id, long action)
+{
+    // The state to recover: 4000K at 40%.
+    CHECK(command(app, client, "{\"id\":20,\"method\":\"set_ct_abx\",\"params\":[4000,\"sudden\",0]}") == ok(20));
+    CHECK(command(app, client, set_bright(21, 40)) == ok(21));
+
+    calls.clear();
+    auto start_cf = "{\"id\":" + std::to_string(id) + ",\"method\":\"start_cf\",\"params\":[5," +
+        std::to_string(action) + ",\"80,1,255,100, 60,7,0,0, 20,2,2700,50\"]}";
+    CHECK(command(app, client, start_cf) == ok(id));
+    CHECK(command(app, client, "{\"id\":22,\"method\":\"get_prop\",\"params\":[\"flowing\"]}") ==
+          "{\"id\":22,\"result\":[\"1\"]}");
+
+    auto start = millis();
+    std::string flowing;
+    while (millis() - start < 2000) {
+        flowing = command(app, client, "{\"id\":23,\"method\":\"get_prop\",\"params\":[\"flowing\"]}");
+        if (flowing.find("\"0\"") != std::string::npos)
+            break;
+    }
+    // 5 changes (one of them a sleep), the last one of 80ms.
+    auto elapsed = millis() - start;
+    CHECK(elapsed >= 80 + 60 + 50 + 80 && elapsed < 1000);
+    for (int i = 0; i < 3; i++)
+        app.loop();
+    return calls;
+}
+
+static void test_flows(TestApp &app, Client &client, TestLamp<> &lamp)
+{
+    auto &values = lamp.state.remote_values;
+    lamp.state.add_new_remote_values_callback([&lamp]() { calls.push_back(lamp.state.remote_values); });
+
+    // Action 0: recover the state from before the flow. The flow steps
+    // are blue at 100%, (sleep), 2700K at 50%, blue at 100%, (sleep).
+    auto steps = run_flow(app, client, lamp, 30, 0);
+    CHECK(steps.size() == 4);
+    if (steps.size() == 4) {
+        CHECK(has_rgb(steps[0], 0, 0, 1) && steps[0].get_brightness() == 1);
+        CHECK(has_ct(steps[1], 1000000.0f / 2700) && near(steps[1].get_brightness(), 0.5f));
+        CHECK(has_rgb(steps[2], 0, 0, 1));
+    }
+    CHECK(values.get_state() == 1 && has_ct(values, 250) && near(values.get_brightness(), 0.4f));
+
+    // Action 1: stay at the last step.
+    steps = run_flow(app, client, lamp, 31, 1);
+    CHECK(steps.size() == 3);
+    CHECK(values.get_state() == 1 && has_rgb(values, 0, 0, 1) && values.get_brightness() == 1);
+
+    // Action 2: turn off.
+    steps = run_flow(app, client, lamp, 32, 2);
+    CHECK(steps.size() == 4);
+    CHECK(values.get_state() == 0);
+    app.loop();
+    CHECK(!lamp.master1.get_state());
+
+    // stop_cf stops an endless flow where it is.
+    CHECK(command(app, client, "{\"id\":33,\"method\":\"set_power\",\"params\":[\"on\"]}") == ok(33));
+    CHECK(command(app, client, "{\"id\":34,\"method\":\"start_cf\",\"params\":[0,0,\"50,1,65280,80,50,1,255,80\"]}") == ok(34));
+    calls.clear();
+    auto start = millis();
+    while (millis() - start < 300)
+        app.loop();
+    CHECK(calls.size() >= 4);
+    CHECK(command(app, client, "{\"id\":35,\"method\":\"stop_cf\",\"params\":[]}") == ok(35));
+    auto stopped = calls.size();
+    start = millis();
+    while (millis() - start < 200)
+        app.loop();
+    CHECK(calls.size() == stopped);
+    CHECK(values.get_state() == 1 && near(values.get_brightness(), 0.8f));
+    CHECK(has_rgb(values, 0, 1, 0) || has_rgb(values, 0, 0, 1));
+}
+
+static void test_replies(TestApp &app, Client &client)
+{
+    // Sent in a single batch, to also cover pipelining.
+    const char *commands[] = {
+        "{\"id\":1,\"method\":\"set_power\",\"params\":[\"on\",\"sudden\",0]}",
+        "{\"id\":2,\"method\":\"set_bright\",\"params\":[50,\"sudden\",0]}",
+        "{\"id\":12345678901234567890,\"method\":\"toggle\",\"params\":[]}",
+        "{\"id\":3,\"method\":\"set_bright\",\"params\":[99999999999999999999,\"sudden\",0]}",
+        "{\"id\":4,\"method\":\"set_bright\",\"params\":[123456789,\"sudden\",0]}",
+        "{\"id\":5,\"method\":\"start_cf\",\"params\":[1,0,\"500,1,255,100,99999999999,1,255,100\"]}",
+        "{\"id\":6,\"method\":\"start_cf\",\"params\":[1,0,\"500,1,-,100\"]}",
+        "{\"id\":7,\"method\":\"get_prop\",\"params\":[\"power\",\"bright\",\"flowing\"]}",
+    };
+    const char *expected[] = {
+        "{\"id\":1,\"result\":[\"ok\"]}",
+        "{\"id\":2,\"result\":[\"ok\"]}",
+        "{\"id\":0,\"error\":{\"code\":-1,\"message\":\"invalid command\"}}",
+        "{\"id\":0,\"error\":{\"code\":-1,\"message\":\"invalid command\"}}",
+        "{\"id\":4,\"error\":{\"code\":-1,\"message\":\"invalid params\"}}",
+        "{\"id\":5,\"error\":{\"code\":-1,\"message\":\"invalid params\"}}",
+        "{\"id\":6,\"error\":{\"code\":-1,\"message\":\"invalid params\"}}",
+        "{\"id\":7,\"result\":[\"on\",\"50\",\"0\"]}",
+    };
+    std::string batch;
+    for (auto command : commands)
+        batch += std::string(command) + "\r\n";
+    client.send_line(batch.substr(0, batch.size() - 2));
+
+    auto replies = run_until_replies(app, client, 8);
+    CHECK(replies.size() == 8);
+    for (size_t i = 0; i < replies.size() && i < 8; i++) {
+        if (replies[i] != expected[i])
+            printf("reply %zu: %s\n", i, replies[i].c_str());
+        CHECK(replies[i] == expected[i]);
+    }
+}
+
+/**
+ * One command at a time: the client waits for the reply and for the
+ * duties to change, before sending the next command.
+ */
+static void test_latency(TestApp &app, Client &client, TestLamp<> &lamp, rgbww::YeelightLanServer &server)
+{
+    const int count = 500;
+    std::vector<uint32_t> latencies;
+    int applied = 0;
+    for (int i = 0; i < count; i++) {
+        auto before = lamp.duties();
+        client.send_line(set_bright(100 + i, i % 2 == 0 ? 30 : 70));
+        auto replies = run_until_replies(app, client, 1);
+        for (int j = 0; j < 10 && lamp.duties() == before; j++)
+            app.loop();
+        if (replies.size() == 1 && lamp.duties() != before)
+            applied++;
+        latencies.push_back(server.get_last_latency());
+    }
+    CHECK(applied == count);
+    CHECK(!HighFrequencyLoopRequester::is_high_frequency());
+
+    std::sort(latencies.begin(), latencies.end());
+    uint64_t total = 0;
+    for (auto latency : latencies)
+        total += latency;
+    printf("command to duty latency: mean %llu us, median %u us, max %u us (%d commands)\n",
+           static_cast<unsigned long long>(total / count), latencies[count / 2], latencies.back(), count);
+    // Without the high frequency loop, the write would wait for the
+    // next loop iteration, up to 16ms later.
+    CHECK(latencies[count / 2] < TestApp::LOOP_INTERVAL / 4);
+    CHECK(latencies.front() > 0);
+}
+
+/**
+ * Pipelined commands, with a fixed number of commands in flight.
+ */
+static void test_throughput(TestApp &app, Client &client, TestLamp<> &lamp, rgbww::YeelightLanServer &server)
+{
+    const long count = 20000;
+    const long in_flight = 16;
+    long sent = 0;
+    long replied = 0;
+    long errors = 0;
+    auto handled_before = server.get_commands_handled();
+    auto iterations_before = app.get_iterations();
+    auto start = micros();
+    while (replied < count && micros() - start < 30000000) {
+        std::string batch;
+        for (; sent < count && sent - replied < in_flight; sent++)
+            batch += set_bright(1000 + sent, 1 + sent % 100) + "\r\n";
+        if (!batch.empty())
+            send(client.fd, batch.data(), batch.size(), 0);
+        app.loop();
+        for (auto &reply : client.take_replies()) {
+            replied++;
+            if (reply.find("\"ok\"") == std::string::npos)
+                errors++;
+        }
+    }
+    auto elapsed = micros() - start;
+    CHECK(replied == count);
+    CHECK(errors == 0);
+    CHECK(server.get_commands_handled() - handled_before == static_cast<uint32_t>(count));
+    printf("throughput: %.0f cmd/s (%ld commands, %ld in flight, %u loop iterations, %.1f s)\n",
+           count * 1e6 / elapsed, count, in_flight, app.get_iterations() - iterations_before, elapsed / 1e6);
+}
+
+int main()
+{
+    TestLamp<> lamp;
+    rgbww::YeelightLanServer server;
+    server.set_light_state(&lamp.state);
+    server.set_output(&lamp.output);
+    server.set_port(TEST_PORT);
+    // Same order as on the device: the light state has the higher setup
+    // priority, so it loops before the server.
+    TestApp app {&lamp.state, &server};
+    app.setup();
+    CHECK(!server.is_failed());
+
+    Client client;
+    CHECK(client.connect_to(TEST_PORT));
+    if (esphome_test::failures() > 0)
+        return esphome_test::result();
+    app.loop();
+
+    test_parser();
+    test_replies(app, client);
+    test_methods(app, client, lamp);
+    test_flows(app, client, lamp);
+    test_latency(app, client, lamp, server);
+    test_throughput(app, client, lamp, server);
+
+    return esphome_test::result();
+}
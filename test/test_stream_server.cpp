@@ -0,0 +1,323 @@
+// Sends DDP packets to the stream server over loopback UDP. Checks how
+// frames are applied, the lost / late packet accounting (including gaps
+// that are too large to tell apart from late packets by sequence number)
+// and the timeout. Every supported frame type must result in the same
+// duties as the light state would produce for the same color, and other
+// DDP data types must be dropped. Reports the packet-to-duty latency
+// within an emulated application loop.
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "test_helpers.h"
+#include "yeelight_stream_server.h"
+
+using namespace esphome;
+using esphome_test::TestApp;
+using esphome_test::TestLamp;
+
+static const uint16_t TEST_PORT = 54048;
+
+struct Sender {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    uint8_t sequence = 0;
+
+    uint8_t next_sequence()
+    {
+        sequence = sequence % 15 + 1;
+        return sequence;
+    }
+
+    void skip(int count)
+    {
+        for (int i = 0; i < count; i++)
+            next_sequence();
+    }
+
+    void send_packet(uint8_t sequence, uint8_t type, const std::vector<uint8_t> &payload)
+    {
+        std::vector<uint8_t> packet {
+            0x41, sequence, type, 0x01, 0, 0, 0, 0,
+            0, static_cast<uint8_t>(payload.size()) };
+        packet.insert(packet.end(), payload.begin(), payload.end());
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(TEST_PORT);
+        sendto(fd, packet.data(), packet.size(), 0, (struct sockaddr *) &address, sizeof(address));
+    }
+
+    /**
+     * Sends raw duty cycles, of which the white channel is used for
+     * identifying the frame.
+     */
+    void send_frame(uint8_t sequence, uint8_t id)
+    {
+        send_packet(sequence, rgbww::DDP_TYPE_DUTIES, { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, id, 0 });
+    }
+
+    void send_frame(uint8_t id) { send_frame(next_sequence(), id); }
+};
+
+static uint32_t frame_duty(uint8_t id)
+{
+    return lroundf((id << 8) / 65535.0f * 16383);
+}
+
+struct Counts {
+    uint32_t received;
+    uint32_t lost;
+    uint32_t late;
+};
+
+static Counts counts(const rgbww::YeelightStreamServer &server)
+{
+    return { server.get_packets_received(), server.get_packets_lost(), server.get_packets_late() };
+}
+
+static void test_sequence(TestApp &app, TestLamp<> &lamp, rgbww::YeelightStreamServer &server, Sender &sender)
+{
+    // Normal stream, then a gap of 2 lost packets.
+    sender.send_frame(10);
+    app.loop();
+    CHECK(lamp.output.is_streaming());
+    CHECK(lamp.white.get_duty() == frame_duty(10));
+    sender.send_frame(11);
+    sender.skip(2);
+    sender.send_frame(12);
+    app.loop();
+    CHECK(lamp.white.get_duty() == frame_duty(12));
+    auto c = counts(server);
+    CHECK(c.received == 3 && c.lost == 2 && c.late == 0);
+
+    // A late packet is not applied.
+    sender.send_frame(sender.sequence - 1, 13);
+    app.loop();
+    CHECK(lamp.white.get_duty() == frame_duty(12));
+    c = counts(server);
+    CHECK(c.received == 4 && c.lost == 2 && c.late == 1);
+
+    // A gap of 9 lost packets, with the stream going on at full rate. The
+    // first packets after the gap look late; the sequence is resynchronized
+    // on the third consecutive one.
+    sender.skip(9);
+    sender.send_frame(14);
+    app.loop();
+    sender.send_frame(15);
+    app.loop();
+    CHECK(lamp.white.get_duty() == frame_duty(12));
+    sender.send_frame(16);
+    app.loop();
+    CHECK(lamp.white.get_duty() == frame_duty(16));
+    sender.send_frame(17);
+    app.loop();
+    CHECK(lamp.white.get_duty() == frame_duty(17));
+    c = counts(server);
+    CHECK(c.received == 8 && c.lost == 11 && c.late == 1);
+
+    // The same, with all packets arriving within a single loop iteration.
+    sender.skip(12);
+    sender.send_frame(18);
+    sender.send_frame(19);
+    sender.send_frame(20);
+    sender.send_frame(21);
+    app.loop();
+    CHECK(lamp.white.get_duty() == frame_duty(21));
+    c = counts(server);
+    CHECK(c.received == 12 && c.lost == 23 && c.late == 1);
+
+    // A gap of 10 lost packets during a pause in the stream. The first
+    // packet after the pause is applied right away.
+    sender.skip(10);
+    usleep((rgbww::STREAM_RESYNC_TIME + 20) * 1000);
+    sender.send_frame(22);
+    app.loop();
+    CHECK(lamp.white.get_duty() == frame_duty(22));
+    c = counts(server);
+    CHECK(c.received == 13 && c.lost == 33 && c.late == 1);
+
+    // Alternating late packets do not form a run, and are not applied.
+    auto sequence = sender.sequence;
+    sender.send_frame((sequence + 13) % 15 + 1, 23);
+    sender.send_frame((sequence + 11) % 15 + 1, 24);
+    sender.send_frame((sequence + 13) % 15 + 1, 25);
+    sender.send_frame((sequence + 11) % 15 + 1, 26);
+    app.loop();
+    CHECK(lamp.white.get_duty() == frame_duty(22));
+    c = counts(server);
+    CHECK(c.received == 17 && c.lost == 33 && c.late == 5);
+    sender.send_frame(27);
+    app.loop();
+    CHECK(lamp.white.get_duty() == frame_duty(27));
+}
+
+static void test_timeout(TestApp &app, TestLamp<> &lamp, rgbww::YeelightStreamServer &server, Sender &sender)
+{
+    auto start = millis();
+    while (lamp.output.is_streaming() && millis() - start < 1000)
+        app.loop();
+    CHECK(!lamp.output.is_streaming());
+    CHECK(!HighFrequencyLoopRequester::is_high_frequency());
+    CHECK(millis() - start >= 200);
+    // Back to the light state (warm white at 50%).
+    CHECK(lamp.white.get_duty() != frame_duty(27));
+    CHECK(lamp.white.get_duty() > 0 && lamp.master1.get_state());
+
+    // After a timeout, the sender may start a new sequence anywhere.
+    sender.skip(8);
+    sender.send_frame(30);
+    app.loop();
+    CHECK(lamp.output.is_streaming());
+    CHECK(HighFrequencyLoopRequester::is_high_frequency());
+    CHECK(lamp.white.get_duty() == frame_duty(30));
+}
+
+/**
+ * The duties that write_state() produces for a light state.
+ */
+static std::array<uint32_t, 4> expected_duties(float state, bool white, float red, float green, float blue,
+                                               float temperature, float brightness)
+{
+    TestLamp<> reference;
+    light::LightColorValues values;
+    values.set_state(state);
+    values.set_brightness(brightness);
+    values.set_white(white ? 1.0f : 0.0f);
+    values.set_red(red);
+    values.set_green(green);
+    values.set_blue(blue);
+    values.set_color_temperature(temperature);
+    reference.state.current_values = values;
+    reference.output.write_state(&reference.state);
+    return reference.duties();
+}
+
+static std::array<uint32_t, 4> rgb_duties(float red, float green, float blue, float brightness)
+{
+    return expected_duties(1, false, red, green, blue, 0, brightness);
+}
+
+static std::array<uint32_t, 4> white_duties(float temperature, float brightness)
+{
+    return expected_duties(1, true, 1, 1, 1, temperature, brightness);
+}
+
+static const std::array<uint32_t, 4> OFF_DUTIES = expected_duties(0, false, 1, 1, 1, 0, 1);
+
+static void send_and_check(TestApp &app, TestLamp<> &lamp, Sender &sender, uint8_t type,
+                           const std::vector<uint8_t> &payload, const std::array<uint32_t, 4> &expected,
+                           bool on = true)
+{
+    sender.send_packet(sender.next_sequence(), type, payload);
+    app.loop();
+    if (lamp.duties() != expected)
+        printf("type 0x%02x: duties %u %u %u %u, expected %u %u %u %u\n", type,
+               lamp.duties()[0], lamp.duties()[1], lamp.duties()[2], lamp.duties()[3],
+               expected[0], expected[1], expected[2], expected[3]);
+    CHECK(lamp.duties() == expected);
+    CHECK(lamp.master1.get_state() == on);
+}
+
+static void test_frame_types(TestApp &app, TestLamp<> &lamp, rgbww::YeelightStreamServer &server, Sender &sender)
+{
+    // Plain 8 bit RGB: the strongest channel determines the brightness.
+    for (uint8_t type : { rgbww::DDP_TYPE_UNDEFINED, rgbww::DDP_TYPE_RGB_LEGACY, rgbww::DDP_TYPE_RGB8 }) {
+        send_and_check(app, lamp, sender, type, { 255, 128, 0 }, rgb_duties(1, 128 / 255.0f, 0, 1));
+        auto brightness = 128 / 255.0f;
+        send_and_check(app, lamp, sender, type, { 32, 128, 64 },
+                       rgb_duties((32 / 255.0f) / brightness, 1, (64 / 255.0f) / brightness, brightness));
+        send_and_check(app, lamp, sender, type, { 0, 0, 0 }, OFF_DUTIES, false);
+    }
+    // Dim white is the night light, like it is for the light state.
+    send_and_check(app, lamp, sender, rgbww::DDP_TYPE_RGB8, { 1, 1, 1 }, rgb_duties(1, 1, 1, 0.01f));
+    CHECK(rgb_duties(1, 1, 1, 0.01f) != rgb_duties(1, 1, 1, 0.02f));
+
+    // RGB + brightness.
+    send_and_check(app, lamp, sender, rgbww::DDP_TYPE_RGB_BRIGHTNESS, { 255, 0, 64, 200 },
+                   rgb_duties(1, 0, 64 / 255.0f, 200 / 255.0f));
+    send_and_check(app, lamp, sender, rgbww::DDP_TYPE_RGB_BRIGHTNESS, { 0, 255, 0, 1 },
+                   rgb_duties(0, 1, 0, 0.01f));
+    send_and_check(app, lamp, sender, rgbww::DDP_TYPE_RGB_BRIGHTNESS, { 255, 255, 255, 2 },
+                   rgb_duties(1, 1, 1, 0.01f));
+    send_and_check(app, lamp, sender, rgbww::DDP_TYPE_RGB_BRIGHTNESS, { 255, 0, 0, 0 }, OFF_DUTIES, false);
+    send_and_check(app, lamp, sender, rgbww::DDP_TYPE_RGB_BRIGHTNESS, { 0, 0, 0, 255 }, OFF_DUTIES, false);
+
+    // White: color temperature (mireds) + brightness.
+    send_and_check(app, lamp, sender, rgbww::DDP_TYPE_WHITE, { 0x01, 0x72, 128 }, white_duties(370, 128 / 255.0f));
+    send_and_check(app, lamp, sender, rgbww::DDP_TYPE_WHITE, { 0x00, 0x99, 255 }, white_duties(153, 1));
+    send_and_check(app, lamp, sender, rgbww::DDP_TYPE_WHITE, { 0x02, 0x4C, 1 }, white_duties(588, 0.01f));
+    send_and_check(app, lamp, sender, rgbww::DDP_TYPE_WHITE, { 0x01, 0x72, 0 }, OFF_DUTIES, false);
+
+    // Other data types are dropped, without being counted as received.
+    send_and_check(app, lamp, sender, rgbww::DDP_TYPE_WHITE, { 0x01, 0x00, 200 }, white_duties(256, 200 / 255.0f));
+    auto received = server.get_packets_received();
+    auto before = lamp.duties();
+    // RGBW, grayscale, RGB 16 bit, RGB with undefined size, undefined custom.
+    for (uint8_t type : { 0x1B, 0x23, 0x0C, 0x08, 0x83 })
+        send_and_check(app, lamp, sender, type, { 255, 0, 0, 0, 0, 0, 0, 0 }, before);
+    CHECK(server.get_packets_received() == received);
+    CHECK(server.get_packets_lost() == 33);
+}
+
+/**
+ * Packets are sent at a random point within the loop interval. While
+ * streaming, the loop does not wait for the loop interval, so packets
+ * are applied in the next loop iteration.
+ */
+static void test_latency(TestApp &app, TestLamp<> &lamp, Sender &sender)
+{
+    const int count = 200;
+    uint64_t total = 0;
+    std::vector<uint32_t> latencies;
+    for (int i = 0; i < count; i++) {
+        auto id = static_cast<uint8_t>(i % 2 == 0 ? 40 : 80);
+        // Send at a random point within the loop interval.
+        usleep(esphome::random_uint32() % TestApp::LOOP_INTERVAL);
+        auto start = micros();
+        sender.send_frame(id);
+        while (lamp.white.get_duty() != frame_duty(id) && micros() - start < 100000)
+            app.loop();
+        auto latency = micros() - start;
+        total += latency;
+        latencies.push_back(latency);
+    }
+    std::sort(latencies.begin(), latencies.end());
+    printf("packet to duty latency: mean %llu us, median %u us, max %u us (%u us loop interval, %d packets)\n",
+           static_cast<unsigned long long>(total / count), latencies[count / 2], latencies.back(),
+           TestApp::LOOP_INTERVAL, count);
+    // Without the high frequency loop, the mean and median are about half
+    // the loop interval.
+    CHECK(latencies[count / 2] < TestApp::LOOP_INTERVAL / 4);
+}
+
+int main()
+{
+    TestLamp<> lamp;
+    rgbww::YeelightStreamServer server;
+    server.set_output(&lamp.output);
+    server.set_port(TEST_PORT);
+    server.set_timeout(200);
+    TestApp app {&lamp.state, &server};
+    app.setup();
+    CHECK(!server.is_failed());
+
+    auto call = lamp.state.make_call();
+    call.set_state(true);
+    call.set_color_temperature(370);
+    call.set_brightness(0.5f);
+    call.perform();
+    app.loop();
+
+    Sender sender;
+    test_sequence(app, lamp, server, sender);
+    test_timeout(app, lamp, server, sender);
+    test_frame_types(app, lamp, server, sender);
+    test_latency(app, lamp, sender);
+
+    return esphome_test::result();
+}
@@ -65,13 +65,24 @@ public:
     float blue = 0;
     float white = 0;
 
+    /**
+     * Sets the tables to use for the white light mapping. The tables are
+     * not copied, so they must stay available while in use (e.g. calibration
+     * tables that are memory mapped from flash).
+     */
+    void set_rgbw_levels(const RGBWLevelsTable *levels_1, const RGBWLevelsTable *levels_100)
+    {
+        rgbw_levels_1_ptr_ = levels_1;
+        rgbw_levels_100_ptr_ = levels_100;
+    }
+
     void set_color(float temperature, float brightness)
     {
         temperature = clamp_temperature_(temperature);
         brightness = clamp_brightness_(brightness);
 
-        auto levels_1 = lookup_in_table_(rgbw_levels_1_, temperature);
-        auto levels_100 = lookup_in_table_(rgbw_levels_100_, temperature);
+        auto levels_1 = lookup_in_table_(*rgbw_levels_1_ptr_, temperature);
+        auto levels_100 = lookup_in_table_(*rgbw_levels_100_ptr_, temperature);
 
         red = interpolate_(levels_1.red, levels_100.red, brightness);
         green = interpolate_(levels_1.green, levels_100.green, brightness);
@@ -80,6 +91,9 @@ public:
     }
 
 protected:
+    const RGBWLevelsTable *rgbw_levels_1_ptr_ = &rgbw_levels_1_;
+    const RGBWLevelsTable *rgbw_levels_100_ptr_ = &rgbw_levels_100_;
+
     float clamp_temperature_(float temperature)
     {
         if (temperature < MIRED_MAX)
@@ -98,9 +112,9 @@ protected:
         return brightness;
     }
 
-    RGBWLevelsByTemperature lookup_in_table_(RGBWLevelsTable table, float temperature)
+    RGBWLevelsByTemperature lookup_in_table_(const RGBWLevelsTable &table, float temperature)
     {
-        for (RGBWLevelsByTemperature& item : table) 
+        for (const RGBWLevelsByTemperature& item : table) 
             if (temperature >= item.from_temperature) 
                 return item;
         throw std::invalid_argument("received too low temperature");
@@ -1,9 +1,12 @@
 #pragma once
 
 #include "esphome/core/component.h"
+#include "esphome/core/helpers.h"
 #include "esphome/components/ledc/ledc_output.h"
 #include "esphome/components/light/light_output.h"
 #include "esphome/components/gpio/output/gpio_binary_output.h"
+#include "calibration.h"
+#include "duty_schedule.h"
 
 
 // What seems to be a bug in ESPHome transitioning: when turning on
@@ -84,18 +87,161 @@ namespace rgbww {
             master2_ = master2;
         }
 
+        /**
+         * Loads the calibration tables from the flash partition with the
+         * provided label. The tables are used in place from flash. When no
+         * valid calibration image is found, the built-in tables are used.
+         */
+        void load_calibration(const char *partition_label)
+        {
+            auto start = micros();
+#ifdef ARDUINO_ARCH_ESP32
+            bool loaded = calibration_.map_partition(partition_label);
+#else
+            bool loaded = calibration_.map_file(partition_label);
+#endif
+            auto duration = micros() - start;
+            if (!loaded) {
+                ESP_LOGW(TAG, "Using built-in calibration: %s", calibration_.get_error());
+                return;
+            }
+            rgb_light_.set_rgb_circle(calibration_.rgb_circle);
+            white_light_.set_rgbw_levels(calibration_.rgbw_levels_1, calibration_.rgbw_levels_100);
+            duty_schedule_.reset();
+            ESP_LOGI(TAG, "Using calibration from '%s' (loaded in %u us)", partition_label, duration);
+        }
+
         void write_state(light::LightState *state) override
         {
-            auto values = state->current_values;
+            // While streaming, the LEDs are driven by the stream server.
+            // The light state is remembered, so it can be restored when
+            // streaming ends.
+            light_state_ = state;
+            if (!streaming_)
+                apply_state_(state);
+            state_written_callback_.call();
+        }
 
-            ESP_LOGD(TAG, "write_state: STATE %f, RGB %f %f %f, BRI %f, TEMP %f",
-                     values.get_state(),
-                     values.get_red(), values.get_green(), values.get_blue(),
-                     values.get_brightness(), values.get_color_temperature());
+        /**
+         * Registers a callback, which is called after every write_state()
+         * call, once the new light state has been written to the LEDC
+         * outputs (or found to not change the duty ticks).
+         */
+        void add_on_state_written_callback(std::function<void()> &&callback)
+        {
+            state_written_callback_.add(std::move(callback));
+        }
+
+        /**
+         * The number of write_state() calls for which the LED duty cycles
+         * were computed and written to the outputs.
+         */
+        uint32_t get_frames_computed() const { return frames_computed_; }
+
+        /**
+         * The number of write_state() calls that were skipped, because they
+         * would not have changed the LEDC duty ticks on any channel.
+         */
+        uint32_t get_frames_skipped() const { return frames_skipped_; }
+
+        /**
+         * Hands over control of the LEDs to a stream of frames. Until
+         * stop_streaming() is called, state changes from the light state
+         * are not applied.
+         */
+        void start_streaming()
+        {
+            ESP_LOGD(TAG, "Start streaming mode");
+            streaming_ = true;
+            duty_schedule_.reset();
+        }
+
+        /**
+         * Ends streaming mode, and restores the LEDs to the light state.
+         */
+        void stop_streaming()
+        {
+            ESP_LOGD(TAG, "Stop streaming mode");
+            streaming_ = false;
+            duty_schedule_.reset();
+            if (light_state_ != nullptr)
+                write_state(light_state_);
+            else
+                turn_off_();
+        }
+
+        bool is_streaming() const { return streaming_; }
+
+        /**
+         * Streaming: drive the LEDs using an RGB color (0 - 1) and brightness
+         * (0.01 - 1), using the same calibrated mapping as write_state().
+         */
+        void stream_rgb(float red, float green, float blue, float brightness)
+        {
+            if (red == 1 && green == 1 && blue == 1 && brightness < 0.012f) {
+                drive_(night_light_.red, night_light_.green, night_light_.blue, night_light_.white);
+                return;
+            }
+            rgb_light_.set_color(red, green, blue, brightness, 1);
+            drive_(rgb_light_.red, rgb_light_.green, rgb_light_.blue, 0);
+        }
+
+        /**
+         * Streaming: drive the LEDs using a color temperature (mireds) and
+         * brightness (0.01 - 1), using the same calibrated mapping as
+         * write_state().
+         */
+        void stream_white(float temperature, float brightness)
+        {
+            white_light_.set_color(temperature, brightness);
+            drive_(white_light_.red, white_light_.green, white_light_.blue, white_light_.white);
+        }
+
+        /**
+         * Streaming: drive the LEDs using raw duty cycles (0 - 1). Note that
+         * the RGB channels are active low: a duty cycle of 1 means off.
+         */
+        void stream_duties(float red, float green, float blue, float white)
+        {
+            drive_(red, green, blue, white);
+        }
+
+        void stream_off()
+        {
+            turn_off_();
+        }
+
+    protected:
+        ledc::LEDCOutput *red_;
+        ledc::LEDCOutput *green_;
+        ledc::LEDCOutput *blue_;
+        ledc::LEDCOutput *white_;
+        esphome::gpio::GPIOBinaryOutput *master1_;
+        esphome::gpio::GPIOBinaryOutput *master2_;
+        esphome::rgbww::yeelight_bs2::WhiteLight white_light_;
+        esphome::rgbww::yeelight_bs2::RGBLight rgb_light_;
+        esphome::rgbww::yeelight_bs2::NightLight night_light_;
+        esphome::rgbww::yeelight_bs2::Calibration calibration_;
+        esphome::rgbww::yeelight_bs2::DutySchedule duty_schedule_;
+        uint32_t frames_computed_ = 0;
+        uint32_t frames_skipped_ = 0;
+        light::LightState *light_state_ = nullptr;
+        CallbackManager<void()> state_written_callback_;
+        bool streaming_ = false;
+#ifdef TRANSITION_TO_OFF_BUGFIX
+        float previous_state_ = 1;
+        float previous_brightness_ = -1;
+#endif
+
+        void apply_state_(light::LightState *state)
+        {
+            auto values = state->current_values;
 
             // Power down the light when its state is 'off'.
             if (values.get_state() == 0)
             {
+                ESP_LOGD(TAG, "write_state: STATE off");
+                duty_schedule_.reset();
                 turn_off_();
 #ifdef TRANSITION_TO_OFF_BUGFIX
                 previous_state_ = -1;
@@ -123,23 +269,48 @@ namespace rgbww {
             previous_state_ = values.get_state();
 #endif
 
-            // Leave it to the default tooling to figure out the basics.
-            // Because of the color interlocking, there are two possible outcomes:
-            // - red, green, blue zero -> the light is in color temperature mode
-            // - cwhite, wwhite zero -> the light is in RGB mode
-            float red, green, blue, cwhite, wwhite;
-            state->current_values_as_rgbww(&red, &green, &blue, &cwhite, &wwhite, true, false);
-
-            if (cwhite > 0 || wwhite > 0)
-            {
-                turn_on_in_white_mode_(values.get_color_temperature(), brightness);
-            }
+            // Because of the color interlocking, the white value is either
+            // 1 (color temperature mode) or 0 (RGB mode). This is what
+            // current_values_as_rgbww() bases its cold/warm white output on,
+            // so there is no need to do that full conversion here.
+            yeelight_bs2::LightMode mode;
+            if (values.get_white() > 0 && brightness > 0)
+                mode = yeelight_bs2::LIGHT_MODE_WHITE;
             else if (
                 values.get_red() == 1 &&
                 values.get_green() == 1 &&
                 values.get_blue() == 1 &&
-                brightness < 0.012f) {
+                brightness < 0.012f)
+                mode = yeelight_bs2::LIGHT_MODE_NIGHT;
+            else
+                mode = yeelight_bs2::LIGHT_MODE_RGB;
+
+            // During slow transitions, most frames would result in the same
+            // LEDC duty ticks as the previous frame. Skip those frames, before
+            // doing any logging or color work.
+            if (duty_schedule_.can_skip(
+                mode, values.get_red(), values.get_green(), values.get_blue(),
+                values.get_color_temperature(), brightness)) {
+                frames_skipped_++;
+                return;
+            }
+            frames_computed_++;
+
+            ESP_LOGD(TAG, "write_state: STATE %f, RGB %f %f %f, BRI %f, TEMP %f",
+                     values.get_state(),
+                     values.get_red(), values.get_green(), values.get_blue(),
+                     brightness, values.get_color_temperature());
+
+            yeelight_bs2::DutyCycles duties;
+            if (mode == yeelight_bs2::LIGHT_MODE_WHITE)
+            {
+                turn_on_in_white_mode_(values.get_color_temperature(), brightness);
+                duties = { white_light_.red, white_light_.green, white_light_.blue, white_light_.white };
+            }
+            else if (mode == yeelight_bs2::LIGHT_MODE_NIGHT)
+            {
                 turn_on_in_night_light_mode_();
+                duties = { night_light_.red, night_light_.green, night_light_.blue, night_light_.white };
             }
             else
             {
@@ -150,23 +321,13 @@ namespace rgbww {
                 turn_on_in_rgb_mode_(
                     values.get_red(), values.get_green(), values.get_blue(),
                     brightness, values.get_state());
+                duties = { rgb_light_.red, rgb_light_.green, rgb_light_.blue, 0.0f };
             }
-        }
 
-    protected:
-        ledc::LEDCOutput *red_;
-        ledc::LEDCOutput *green_;
-        ledc::LEDCOutput *blue_;
-        ledc::LEDCOutput *white_;
-        esphome::gpio::GPIOBinaryOutput *master1_;
-        esphome::gpio::GPIOBinaryOutput *master2_;
-        esphome::rgbww::yeelight_bs2::WhiteLight white_light_;
-        esphome::rgbww::yeelight_bs2::RGBLight rgb_light_;
-        esphome::rgbww::yeelight_bs2::NightLight night_light_;
-#ifdef TRANSITION_TO_OFF_BUGFIX
-        float previous_state_ = 1;
-        float previous_brightness_ = -1;
-#endif
+            duty_schedule_.record(
+                mode, values.get_red(), values.get_green(), values.get_blue(),
+                values.get_color_temperature(), brightness, duties);
+        }
 
         void turn_off_()
         {
@@ -178,6 +339,16 @@ namespace rgbww {
             master1_->turn_off();
         }
 
+        void drive_(float red, float green, float blue, float white)
+        {
+            master2_->turn_on();
+            master1_->turn_on();
+            red_->set_level(red);
+            green_->set_level(green);
+            blue_->set_level(blue);
+            white_->set_level(white);
+        }
+
         void turn_on_in_night_light_mode_()
         {
             ESP_LOGD(TAG, "Activate Night light feature");
@@ -0,0 +1,294 @@
+#pragma once
+
+#include "esphome/core/defines.h"
+
+// The i2c component is only part of the build when an i2c bus is
+// configured. Therefore, this code is only enabled by light.py when the
+// front_panel option is used.
+#ifdef USE_YEELIGHT_BS2_FRONT_PANEL
+
+#include <array>
+#include <cstdint>
+
+#include "esphome/core/component.h"
+#include "esphome/core/esphal.h"
+#include "esphome/core/helpers.h"
+#include "esphome/components/i2c/i2c.h"
+#include "esphome/components/light/light_state.h"
+#include "yeelight_bs2_light_output.h"
+
+namespace esphome {
+namespace rgbww {
+namespace yeelight_bs2 {
+
+// The number of levels that is reported by the front panel slider.
+static const uint8_t SLIDER_LEVELS = 21;
+
+// The number of LEDs in the front panel brightness indicator.
+static const uint8_t PANEL_LEVELS = 10;
+
+// Commands that are written to the front panel. See
+// doc/reverse_engineering/I2C protocol/i2c_commands.txt.
+using PanelCommand = std::array<uint8_t, 7>;
+static const PanelCommand PANEL_READY_FOR_EVENT {{ 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01 }};
+static const PanelCommand PANEL_TURN_OFF {{ 0x02, 0x03, 0x0C, 0x00, 0x64, 0x00, 0x00 }};
+
+enum PanelEventType {
+    PANEL_EVENT_NONE,
+    PANEL_EVENT_POWER_TOUCH,
+    PANEL_EVENT_POWER_RELEASE,
+    PANEL_EVENT_COLOR_TOUCH,
+    PANEL_EVENT_COLOR_RELEASE,
+    PANEL_EVENT_SLIDER_TOUCH,
+    PANEL_EVENT_SLIDER_RELEASE
+};
+
+struct PanelEvent {
+    PanelEventType type = PANEL_EVENT_NONE;
+    // Slider level 1 - 21 (bottom to top), for slider events only.
+    uint8_t level = 0;
+};
+
+/**
+ * Decodes an event as read from the front panel, e.g.
+ * 04 04 01 00 03 15 19 = slider touched at level 1.
+ * Returns an event of type PANEL_EVENT_NONE for invalid data.
+ */
+inline PanelEvent decode_panel_event(const uint8_t *data)
+{
+    PanelEvent event;
+    if (data[0] != 0x04 || data[1] != 0x04)
+        return event;
+    uint8_t checksum = data[2] + data[3] + data[4] + data[5];
+    if (checksum != data[6])
+        return event;
+
+    auto kind = data[4];
+    auto value = data[5];
+    if (kind == 0x01 && value == 0x01)
+        event.type = PANEL_EVENT_POWER_TOUCH;
+    else if (kind == 0x01 && value == 0x02)
+        event.type = PANEL_EVENT_POWER_RELEASE;
+    else if (kind == 0x02 && value == 0x01)
+        event.type = PANEL_EVENT_COLOR_TOUCH;
+    else if (kind == 0x02 && value == 0x02)
+        event.type = PANEL_EVENT_COLOR_RELEASE;
+    else if ((kind == 0x03 || kind == 0x04) && value >= 1 && value <= SLIDER_LEVELS) {
+        event.type = kind == 0x03 ? PANEL_EVENT_SLIDER_TOUCH : PANEL_EVENT_SLIDER_RELEASE;
+        event.level = SLIDER_LEVELS + 1 - value;
+    }
+    return event;
+}
+
+/**
+ * Builds the command that lights up the brightness indicator LEDs
+ * of the front panel, up to the provided level (1 - 10).
+ */
+inline PanelCommand encode_panel_level(uint8_t level)
+{
+    if (level < 1)
+        level = 1;
+    else if (level > PANEL_LEVELS)
+        level = PANEL_LEVELS;
+    uint8_t high = level == 1 ? 0x5E : 0x5F;
+    uint8_t low = level <= 2 ? 0x00 : static_cast<uint8_t>(0xFF << (PANEL_LEVELS - level));
+    return {{ 0x02, 0x03, high, low, 0x64, 0x00, 0x00 }};
+}
+
+struct PanelColorPreset {
+    bool white;
+    float temperature;
+    float red;
+    float green;
+    float blue;
+};
+
+/**
+ * The colors that the color button cycles through.
+ */
+static const std::array<PanelColorPreset, 7> panel_color_presets_ {{
+    { true,  370.0f, 1.0f, 1.0f, 1.0f }, // 2700K, warm white
+    { true,  250.0f, 1.0f, 1.0f, 1.0f }, // 4000K, neutral white
+    { true,  153.0f, 1.0f, 1.0f, 1.0f }, // 6500K, cool white
+    { false, 0.0f,   1.0f, 0.0f, 0.0f }, // red
+    { false, 0.0f,   0.0f, 1.0f, 0.0f }, // green
+    { false, 0.0f,   0.0f, 0.0f, 1.0f }, // blue
+    { false, 0.0f,   1.0f, 0.0f, 1.0f }  // magenta
+}};
+
+} // namespace yeelight_bs2
+
+    static const char *TAG_PANEL = "yeelight_bs2.front_panel";
+
+    /**
+     * This component handles the touch panel on the front of the device.
+     *
+     * Panel events are handled locally, without waiting for a round trip
+     * to Home Assistant: the power button toggles the light, the color
+     * button cycles through a set of color presets, and the slider sets
+     * the brightness. The changes are applied as light calls on the light
+     * state within the loop iteration in which the event is read. The new
+     * state is published to Home Assistant afterwards, by the light state.
+     *
+     * The slider reports 21 levels, and sends events while the finger
+     * moves over it. Between slider levels, a short transition is used
+     * to smooth out the brightness steps.
+     *
+     * After handling an event, a high frequency loop is requested until
+     * the light state has written the new state to the output, so the
+     * LEDs respond in the next loop iteration.
+     */
+    class YeelightFrontPanel : public Component, public i2c::I2CDevice
+    {
+    public:
+        void set_light_state(light::LightState *state) { state_ = state; }
+
+        void set_output(YeelightBS2LightOutput *output) { output_ = output; }
+
+        void set_trigger_pin(GPIOPin *pin) { trigger_pin_ = pin; }
+
+        void set_slider_transition(uint32_t transition) { slider_transition_ = transition; }
+
+        float get_setup_priority() const override { return setup_priority::DATA; }
+
+        void setup() override
+        {
+            output_->add_on_state_written_callback([this]() { on_state_written_(); });
+
+            trigger_pin_->setup();
+            trigger_pin_->attach_interrupt(YeelightFrontPanel::isr_, this, FALLING);
+
+            // Keep the brightness indicator in sync with the light state,
+            // also when it is changed through other channels.
+            state_->add_new_remote_values_callback([this]() { update_panel_leds_(); });
+            update_panel_leds_();
+        }
+
+        void dump_config() override
+        {
+            ESP_LOGCONFIG(TAG_PANEL, "Yeelight front panel:");
+            // Not using LOG_I2C_DEVICE() and LOG_PIN(), since these log
+            // using TAG, which is the tag of the light output here.
+            ESP_LOGCONFIG(TAG_PANEL, "  Address: 0x%02X", address_);
+            ESP_LOGCONFIG(TAG_PANEL, "  Trigger pin: GPIO%u", trigger_pin_->get_pin());
+            ESP_LOGCONFIG(TAG_PANEL, "  Slider transition: %u ms", slider_transition_);
+        }
+
+        void loop() override
+        {
+            if (!event_pending_)
+                return;
+            event_pending_ = false;
+            auto event_time = event_time_;
+
+            uint8_t data[7];
+            if (!write_bytes_raw(yeelight_bs2::PANEL_READY_FOR_EVENT.data(), 7) || !read_bytes_raw(data, 7)) {
+                ESP_LOGW(TAG_PANEL, "Reading front panel event failed");
+                return;
+            }
+            auto event = yeelight_bs2::decode_panel_event(data);
+            if (handle_event_(event) && !latency_pending_) {
+                latency_event_ = event;
+                latency_start_ = event_time;
+                latency_pending_ = true;
+                high_frequency_.start();
+            }
+        }
+
+        /**
+         * The time between the front panel signaling the last measured
+         * event, and the first write of the resulting light state to the
+         * output (microseconds).
+         */
+        uint32_t get_last_latency() const { return last_latency_; }
+
+    protected:
+        light::LightState *state_;
+        YeelightBS2LightOutput *output_;
+        GPIOPin *trigger_pin_;
+        uint32_t slider_transition_ = 100;
+        volatile bool event_pending_ = false;
+        volatile uint32_t event_time_ = 0;
+        uint32_t last_latency_ = 0;
+        uint32_t latency_start_ = 0;
+        yeelight_bs2::PanelEvent latency_event_;
+        bool latency_pending_ = false;
+        HighFrequencyLoopRequester high_frequency_;
+        size_t color_preset_ = 0;
+        uint8_t panel_level_ = 0;
+
+        static void ICACHE_RAM_ATTR isr_(YeelightFrontPanel *panel)
+        {
+            panel->event_time_ = micros();
+            panel->event_pending_ = true;
+        }
+
+        void on_state_written_()
+        {
+            if (!latency_pending_)
+                return;
+            latency_pending_ = false;
+            last_latency_ = micros() - latency_start_;
+            high_frequency_.stop();
+            ESP_LOGD(TAG_PANEL, "Panel event %d (level %u) applied to the LEDs in %u us",
+                     latency_event_.type, latency_event_.level, last_latency_);
+        }
+
+        bool handle_event_(const yeelight_bs2::PanelEvent &event)
+        {
+            switch (event.type) {
+            case yeelight_bs2::PANEL_EVENT_POWER_TOUCH:
+                state_->toggle().perform();
+                return true;
+
+            case yeelight_bs2::PANEL_EVENT_COLOR_TOUCH: {
+                color_preset_ = (color_preset_ + 1) % yeelight_bs2::panel_color_presets_.size();
+                auto &preset = yeelight_bs2::panel_color_presets_[color_preset_];
+                auto call = state_->make_call();
+                call.set_state(true);
+                if (preset.white)
+                    call.set_color_temperature(preset.temperature);
+                else
+                    call.set_rgb(preset.red, preset.green, preset.blue);
+                call.perform();
+                return true;
+            }
+
+            case yeelight_bs2::PANEL_EVENT_SLIDER_TOUCH:
+            case yeelight_bs2::PANEL_EVENT_SLIDER_RELEASE: {
+                // Level 1 maps to the lowest brightness (1%), level 21 to 100%.
+                auto brightness = 0.01f + 0.99f * (event.level - 1) / (yeelight_bs2::SLIDER_LEVELS - 1);
+                auto call = state_->make_call();
+                call.set_state(true);
+                call.set_brightness(brightness);
+                call.set_transition_length(slider_transition_);
+                call.perform();
+                return true;
+            }
+
+            default:
+                return false;
+            }
+        }
+
+        void update_panel_leds_()
+        {
+            // Same mapping as the original firmware: 10% per LED, with at
+            // least one LED lit when the light is on.
+            auto values = state_->remote_values;
+            uint8_t level = values.get_state() == 0 ? 0 :
+                static_cast<uint8_t>(values.get_brightness() * yeelight_bs2::PANEL_LEVELS + 0.5f);
+            if (values.get_state() != 0 && level < 1)
+                level = 1;
+            if (level == panel_level_)
+                return;
+            panel_level_ = level;
+            auto command = level == 0 ? yeelight_bs2::PANEL_TURN_OFF : yeelight_bs2::encode_panel_level(level);
+            write_bytes_raw(command.data(), command.size());
+        }
+    };
+
+} // namespace rgbww
+} // namespace esphome
+
+#endif // USE_YEELIGHT_BS2_FRONT_PANEL
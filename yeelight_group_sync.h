@@ -0,0 +1,624 @@
+#pragma once
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#ifdef ARDUINO_ARCH_ESP32
+#include <lwip/sockets.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+#include "esphome/core/component.h"
+#include "esphome/core/helpers.h"
+#include "esphome/components/light/light_state.h"
+#include "white_light.h"
+
+namespace esphome {
+namespace rgbww {
+
+    static const char *TAG_SYNC = "yeelight_bs2.sync";
+
+    static const uint16_t SYNC_DEFAULT_PORT = 55444;
+
+    // Message header: magic "YS", version, message type, group id and
+    // the id of the sender. All multi-byte values are big-endian.
+    static const uint8_t SYNC_MAGIC_1 = 'Y';
+    static const uint8_t SYNC_MAGIC_2 = 'S';
+    static const uint8_t SYNC_VERSION = 2;
+    static const size_t SYNC_HEADER_SIZE = 9;
+
+    // Message types.
+    static const uint8_t SYNC_TYPE_PING = 1;           // follower -> leader: t1
+    static const uint8_t SYNC_TYPE_PONG = 2;           // leader -> follower: id, t1, t2, t3, flags
+    static const uint8_t SYNC_TYPE_SCENE = 3;          // leader -> group: scene, start time
+    static const uint8_t SYNC_TYPE_SCENE_REQUEST = 4;  // any -> leader: scene
+    static const uint8_t SYNC_TYPE_REPORT = 5;         // follower -> leader: skew
+
+    // Scene flags.
+    static const uint8_t SYNC_SCENE_ON = 0x01;
+    static const uint8_t SYNC_SCENE_WHITE = 0x02;
+
+    // Pong flags. A pong is precise when the leader was running a high
+    // frequency loop when the ping arrived, so the ping was not kept
+    // waiting for the loop interval before being timestamped.
+    static const uint8_t SYNC_PONG_PRECISE = 0x01;
+
+    static const size_t SYNC_BUFFER_SIZE = 40;
+
+    // The number of clock offset samples from which the best one (the
+    // one with the lowest round trip time) is used.
+    static const size_t SYNC_OFFSET_SAMPLES = 8;
+
+    // The number of lamps for which the leader keeps skew reports.
+    static const size_t SYNC_MAX_LAMPS = 8;
+
+    // Followers send pings in rounds. Each ping in a round is sent when
+    // the pong for the previous one comes in. The first ping of a round
+    // wakes up the leader, the others are answered precisely.
+    static const size_t SYNC_PINGS_PER_ROUND = 3;
+
+    // The time (ms) after which an unanswered ping is given up on.
+    static const uint32_t SYNC_PING_TIMEOUT = 250;
+
+    // The time (ms) for which the leader runs a high frequency loop after
+    // receiving a ping, to timestamp the next pings of the round promptly.
+    static const uint32_t SYNC_LEADER_WINDOW = 100;
+
+    /**
+     * A transition target, as distributed to the lamps in a group.
+     */
+    struct GroupScene {
+        bool state = true;
+        bool white = false;
+        float brightness = 1.0f;
+        float red = 1.0f;
+        float green = 1.0f;
+        float blue = 1.0f;
+        float temperature = 0;
+        uint32_t duration = 0;
+    };
+
+    /**
+     * Skew as reported by a lamp in the group, for the last scene.
+     */
+    struct GroupLampSkew {
+        uint32_t lamp_id = 0;
+        uint16_t scene = 0;
+        // Difference between the actual and the scheduled start of the
+        // transition, on the shared timeline (microseconds).
+        int32_t skew = 0;
+        // Round trip time of the clock sample that the offset of the lamp
+        // is based on. Half of this is the bound on the offset error.
+        uint32_t rtt = 0;
+    };
+
+    /**
+     * This component synchronizes transitions between multiple lamps.
+     *
+     * One lamp in the group is configured as the leader. Its clock is used
+     * as the shared timeline for the group. The other lamps (followers)
+     * estimate the offset between their own clock and the leader clock,
+     * by periodically exchanging ping/pong messages over UDP (like NTP does,
+     * using the sample with the lowest round trip time).
+     *
+     * A transition is started by sending a scene request to the leader.
+     * The leader picks a start time a short lead time into the future, and
+     * broadcasts the scene plus start time to the group. Each lamp converts
+     * the start time into its local clock, and starts the transition at
+     * that time. When a lamp starts late, the transition length is reduced
+     * by the same amount, so all lamps reach the target at the same time.
+     *
+     * After starting a transition, followers report their skew to the
+     * leader, which logs them per lamp. A group must have exactly one
+     * leader. A leader that receives pongs or scenes from another leader
+     * in its group logs a warning.
+     *
+     * With the default loop interval of 16ms, both the timestamps of the
+     * clock sync messages and the start of a transition could be off by
+     * up to a full interval. Therefore, a high frequency loop is requested
+     * while these are time critical: while a ping is unanswered, while a
+     * scene is pending (plus one more iteration, in which the light state
+     * writes the first frame) and, for the leader, shortly after a ping.
+     */
+    class YeelightGroupSync : public Component
+    {
+    public:
+        void set_light_state(light::LightState *state) { state_ = state; }
+
+        void set_port(uint16_t port) { port_ = port; }
+
+        void set_broadcast_address(const char *address) { broadcast_address_ = address; }
+
+        void set_group(uint8_t group) { group_ = group; }
+
+        void set_leader(bool leader) { leader_ = leader; }
+
+        void set_lead_time(uint32_t lead_time) { lead_time_ = lead_time; }
+
+        void set_sync_interval(uint32_t sync_interval) { sync_interval_ = sync_interval; }
+
+        float get_setup_priority() const override { return setup_priority::AFTER_WIFI; }
+
+        void setup() override
+        {
+            id_ = random_uint32();
+
+            fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+            if (fd_ < 0) {
+                ESP_LOGE(TAG_SYNC, "Could not create socket (errno %d)", errno);
+                mark_failed();
+                return;
+            }
+            int enable = 1;
+            setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+            setsockopt(fd_, SOL_SOCKET, SO_BROADCAST, &enable, sizeof(enable));
+
+            struct sockaddr_in address;
+            memset(&address, 0, sizeof(address));
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_ANY);
+            address.sin_port = htons(port_);
+            if (bind(fd_, (struct sockaddr *) &address, sizeof(address)) < 0) {
+                ESP_LOGE(TAG_SYNC, "Could not bind to port %u (errno %d)", port_, errno);
+                close(fd_);
+                fd_ = -1;
+                mark_failed();
+                return;
+            }
+            fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL, 0) | O_NONBLOCK);
+
+            memset(&broadcast_, 0, sizeof(broadcast_));
+            broadcast_.sin_family = AF_INET;
+            broadcast_.sin_addr.s_addr = inet_addr(broadcast_address_);
+            broadcast_.sin_port = htons(port_);
+        }
+
+        void dump_config() override
+        {
+            ESP_LOGCONFIG(TAG_SYNC, "Yeelight group sync:");
+            ESP_LOGCONFIG(TAG_SYNC, "  Role: %s", leader_ ? "leader" : "follower");
+            ESP_LOGCONFIG(TAG_SYNC, "  Group: %u", group_);
+            ESP_LOGCONFIG(TAG_SYNC, "  Port: %u", port_);
+            ESP_LOGCONFIG(TAG_SYNC, "  Broadcast address: %s", broadcast_address_);
+            ESP_LOGCONFIG(TAG_SYNC, "  Lead time: %u ms", lead_time_);
+        }
+
+        void loop() override
+        {
+            if (fd_ < 0)
+                return;
+
+            for (;;) {
+                auto len = recv(fd_, rx_, sizeof(rx_), 0);
+                if (len < 0)
+                    break;
+                handle_message_(static_cast<size_t>(len));
+            }
+
+            if (!leader_)
+                update_pings_();
+
+            scene_starting_ = false;
+            if (scene_pending_ && static_cast<int32_t>(micros() - scene_local_start_) >= 0)
+                start_scene_();
+
+            update_high_frequency_();
+        }
+
+        /**
+         * Starts a synchronized transition to an RGB color on all lamps
+         * in the group.
+         */
+        void start_rgb_transition(float red, float green, float blue, float brightness, uint32_t duration)
+        {
+            GroupScene scene;
+            scene.red = red;
+            scene.green = green;
+            scene.blue = blue;
+            scene.brightness = brightness;
+            scene.duration = duration;
+            request_scene(scene);
+        }
+
+        /**
+         * Starts a synchronized transition to a color temperature (mireds)
+         * on all lamps in the group.
+         */
+        void start_white_transition(float temperature, float brightness, uint32_t duration)
+        {
+            GroupScene scene;
+            scene.white = true;
+            scene.temperature = temperature;
+            scene.brightness = brightness;
+            scene.duration = duration;
+            request_scene(scene);
+        }
+
+        /**
+         * Starts a synchronized transition to off on all lamps in the group.
+         */
+        void start_off_transition(uint32_t duration)
+        {
+            GroupScene scene;
+            scene.state = false;
+            scene.duration = duration;
+            request_scene(scene);
+        }
+
+        /**
+         * Starts a synchronized transition to a scene on all lamps in the
+         * group. Values outside the supported ranges (e.g. 0 - 255 instead
+         * of 0 - 1 for colors) are clamped.
+         */
+        void request_scene(const GroupScene &scene)
+        {
+            auto clamped = clamp_scene_(scene);
+            if (leader_)
+                broadcast_scene_(clamped);
+            else
+                send_(SYNC_TYPE_SCENE_REQUEST, broadcast_, write_scene_(tx_ + SYNC_HEADER_SIZE, clamped, 0, 0));
+        }
+
+        /**
+         * The estimated offset between the leader clock and the local clock
+         * (microseconds). Always 0 for the leader.
+         */
+        uint32_t get_clock_offset() const { return offset_; }
+
+        bool has_clock_offset() const { return leader_ || has_offset_; }
+
+        /**
+         * The skew for the last scene as started by this lamp.
+         */
+        const GroupLampSkew &get_skew() const { return skew_; }
+
+        /**
+         * The skews as reported by the lamps in the group (leader only).
+         */
+        const GroupLampSkew *get_lamp_skews() const { return lamp_skews_; }
+
+    protected:
+        struct OffsetSample {
+            uint32_t offset;
+            uint32_t rtt;
+        };
+
+        light::LightState *state_;
+        uint16_t port_ = SYNC_DEFAULT_PORT;
+        const char *broadcast_address_ = "255.255.255.255";
+        uint8_t group_ = 0;
+        bool leader_ = false;
+        uint32_t lead_time_ = 150;
+        uint32_t sync_interval_ = 2000;
+        uint32_t id_ = 0;
+        int fd_ = -1;
+        struct sockaddr_in broadcast_;
+        uint8_t rx_[SYNC_BUFFER_SIZE];
+        uint8_t tx_[SYNC_BUFFER_SIZE];
+
+        HighFrequencyLoopRequester high_frequency_;
+        bool precise_ = false;
+        uint32_t last_ping_received_ = 0;
+        bool pinged_ = false;
+
+        uint32_t last_round_ = 0;
+        size_t round_pings_left_ = 0;
+        bool ping_outstanding_ = false;
+        uint32_t ping_t1_ = 0;
+        uint32_t ping_time_ = 0;
+        OffsetSample samples_[SYNC_OFFSET_SAMPLES];
+        size_t sample_count_ = 0;
+        size_t sample_next_ = 0;
+        uint32_t offset_ = 0;
+        uint32_t offset_rtt_ = 0;
+        bool has_offset_ = false;
+
+        uint16_t scene_sequence_ = 0;
+        bool scene_pending_ = false;
+        bool scene_starting_ = false;
+        GroupScene scene_;
+        uint16_t scene_id_ = 0;
+        uint32_t scene_local_start_ = 0;
+        GroupLampSkew skew_;
+        GroupLampSkew lamp_skews_[SYNC_MAX_LAMPS];
+        uint32_t other_leader_id_ = 0;
+
+        static void write_uint16_(uint8_t *data, uint16_t value)
+        {
+            data[0] = value >> 8;
+            data[1] = value;
+        }
+
+        static void write_uint32_(uint8_t *data, uint32_t value)
+        {
+            data[0] = value >> 24;
+            data[1] = value >> 16;
+            data[2] = value >> 8;
+            data[3] = value;
+        }
+
+        static uint16_t read_uint16_(const uint8_t *data)
+        {
+            return (data[0] << 8) | data[1];
+        }
+
+        static uint32_t read_uint32_(const uint8_t *data)
+        {
+            return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | data[3];
+        }
+
+        void send_(uint8_t type, const struct sockaddr_in &to, size_t payload_len)
+        {
+            tx_[0] = SYNC_MAGIC_1;
+            tx_[1] = SYNC_MAGIC_2;
+            tx_[2] = SYNC_VERSION;
+            tx_[3] = type;
+            tx_[4] = group_;
+            write_uint32_(tx_ + 5, id_);
+            sendto(fd_, tx_, SYNC_HEADER_SIZE + payload_len, 0, (const struct sockaddr *) &to, sizeof(to));
+        }
+
+        void handle_message_(size_t len)
+        {
+            if (len < SYNC_HEADER_SIZE || rx_[0] != SYNC_MAGIC_1 || rx_[1] != SYNC_MAGIC_2 ||
+                rx_[2] != SYNC_VERSION || rx_[4] != group_)
+                return;
+            auto type = rx_[3];
+            auto sender_id = read_uint32_(rx_ + 5);
+            if (sender_id == id_)
+                return;
+            auto data = rx_ + SYNC_HEADER_SIZE;
+            auto data_len = len - SYNC_HEADER_SIZE;
+
+            if (type == SYNC_TYPE_PING && leader_ && data_len >= 4) {
+                // Reply with the follower's send time (t1), the receive
+                // time (t2) and the reply time (t3). The reply is broadcast
+                // as well, to keep the network path symmetric.
+                auto t2 = micros();
+                write_uint32_(tx_ + SYNC_HEADER_SIZE, sender_id);
+                memcpy(tx_ + SYNC_HEADER_SIZE + 4, data, 4);
+                write_uint32_(tx_ + SYNC_HEADER_SIZE + 8, t2);
+                tx_[SYNC_HEADER_SIZE + 16] = precise_ ? SYNC_PONG_PRECISE : 0;
+                write_uint32_(tx_ + SYNC_HEADER_SIZE + 12, micros());
+                send_(SYNC_TYPE_PONG, broadcast_, 17);
+                last_ping_received_ = millis();
+                pinged_ = true;
+            } else if (type == SYNC_TYPE_PONG && !leader_ && data_len >= 17 && read_uint32_(data) == id_) {
+                auto t4 = micros();
+                auto t1 = read_uint32_(data + 4);
+                if (!ping_outstanding_ || t1 != ping_t1_)
+                    return;
+                ping_outstanding_ = false;
+                if (data[16] & SYNC_PONG_PRECISE)
+                    handle_pong_(t1, read_uint32_(data + 8), read_uint32_(data + 12), t4);
+            } else if (type == SYNC_TYPE_SCENE && !leader_ && data_len >= 22) {
+                GroupScene scene;
+                read_scene_(data, scene);
+                schedule_scene_(scene, read_uint16_(data + 16), read_uint32_(data + 18));
+            } else if (type == SYNC_TYPE_SCENE_REQUEST && leader_ && data_len >= 16) {
+                GroupScene scene;
+                read_scene_(data, scene);
+                broadcast_scene_(scene);
+            } else if (type == SYNC_TYPE_REPORT && leader_ && data_len >= 10) {
+                handle_report_(sender_id, read_uint16_(data), read_uint32_(data + 2), read_uint32_(data + 6));
+            } else if ((type == SYNC_TYPE_PONG || type == SYNC_TYPE_SCENE) && leader_ &&
+                       sender_id != other_leader_id_) {
+                // Followers would mix up the clocks and scenes of both.
+                other_leader_id_ = sender_id;
+                ESP_LOGW(TAG_SYNC, "Lamp %08x is a leader in group %u as well", sender_id, group_);
+            }
+        }
+
+        /**
+         * Follower: starts a round of pings every sync interval, and sends
+         * the next ping of the round when the previous one is answered.
+         */
+        void update_pings_()
+        {
+            auto now = millis();
+            if (ping_outstanding_ && now - ping_time_ >= SYNC_PING_TIMEOUT) {
+                ping_outstanding_ = false;
+                round_pings_left_ = 0;
+            }
+            if (ping_outstanding_)
+                return;
+            if (round_pings_left_ == 0 && now - last_round_ >= sync_interval_) {
+                last_round_ = now;
+                round_pings_left_ = SYNC_PINGS_PER_ROUND;
+            }
+            if (round_pings_left_ > 0) {
+                round_pings_left_--;
+                send_ping_();
+            }
+        }
+
+        void send_ping_()
+        {
+            ping_t1_ = micros();
+            ping_time_ = millis();
+            ping_outstanding_ = true;
+            write_uint32_(tx_ + SYNC_HEADER_SIZE, ping_t1_);
+            send_(SYNC_TYPE_PING, broadcast_, 4);
+        }
+
+        void update_high_frequency_()
+        {
+            bool leader_window = leader_ && pinged_ && millis() - last_ping_received_ < SYNC_LEADER_WINDOW;
+            if (scene_pending_ || scene_starting_ || ping_outstanding_ || leader_window)
+                high_frequency_.start();
+            else
+                high_frequency_.stop();
+            // Messages that are read in the next iteration will not have
+            // been waiting for the loop interval.
+            precise_ = HighFrequencyLoopRequester::is_high_frequency();
+        }
+
+        /**
+         * Updates the clock offset, based on the ping send time (t1) and
+         * pong receive time (t4) on the local clock, and the ping receive
+         * time (t2) and pong send time (t3) on the leader clock.
+         */
+        void handle_pong_(uint32_t t1, uint32_t t2, uint32_t t3, uint32_t t4)
+        {
+            OffsetSample sample;
+            sample.rtt = (t4 - t1) - (t3 - t2);
+            // offset = ((t2 - t1) + (t3 - t4)) / 2, written in a way that
+            // works with wrapping clocks.
+            uint32_t forward = t2 - t1;
+            uint32_t backward = t3 - t4;
+            sample.offset = forward + static_cast<uint32_t>(static_cast<int32_t>(backward - forward) / 2);
+            samples_[sample_next_] = sample;
+            sample_next_ = (sample_next_ + 1) % SYNC_OFFSET_SAMPLES;
+            if (sample_count_ < SYNC_OFFSET_SAMPLES)
+                sample_count_++;
+
+            auto best = &samples_[0];
+            for (size_t i = 1; i < sample_count_; i++)
+                if (samples_[i].rtt < best->rtt)
+                    best = &samples_[i];
+            offset_ = best->offset;
+            offset_rtt_ = best->rtt;
+            has_offset_ = true;
+        }
+
+        static float clamp_(float value, float min, float max)
+        {
+            // Written such that NaN results in the minimum.
+            return value > min ? (value < max ? value : max) : min;
+        }
+
+        static GroupScene clamp_scene_(const GroupScene &scene)
+        {
+            auto clamped = scene;
+            clamped.brightness = clamp_(scene.brightness, 0, 1);
+            clamped.red = clamp_(scene.red, 0, 1);
+            clamped.green = clamp_(scene.green, 0, 1);
+            clamped.blue = clamp_(scene.blue, 0, 1);
+            clamped.temperature = clamp_(scene.temperature, yeelight_bs2::MIRED_MAX, yeelight_bs2::MIRED_MIN);
+            return clamped;
+        }
+
+        /**
+         * Writes a scene, of which the values must be within the ranges
+         * as provided by clamp_scene_().
+         */
+        size_t write_scene_(uint8_t *data, const GroupScene &scene, uint16_t id, uint32_t start)
+        {
+            data[0] = (scene.state ? SYNC_SCENE_ON : 0) | (scene.white ? SYNC_SCENE_WHITE : 0);
+            data[1] = 0;
+            write_uint16_(data + 2, static_cast<uint16_t>(scene.brightness * 65535));
+            data[4] = static_cast<uint8_t>(scene.red * 255);
+            data[5] = static_cast<uint8_t>(scene.green * 255);
+            data[6] = static_cast<uint8_t>(scene.blue * 255);
+            data[7] = 0;
+            write_uint32_(data + 8, static_cast<uint32_t>(scene.temperature * 100));
+            write_uint32_(data + 12, scene.duration);
+            write_uint16_(data + 16, id);
+            write_uint32_(data + 18, start);
+            return 22;
+        }
+
+        void read_scene_(const uint8_t *data, GroupScene &scene)
+        {
+            scene.state = data[0] & SYNC_SCENE_ON;
+            scene.white = data[0] & SYNC_SCENE_WHITE;
+            scene.brightness = read_uint16_(data + 2) / 65535.0f;
+            scene.red = data[4] / 255.0f;
+            scene.green = data[5] / 255.0f;
+            scene.blue = data[6] / 255.0f;
+            scene.temperature = read_uint32_(data + 8) / 100.0f;
+            scene.duration = read_uint32_(data + 12);
+        }
+
+        /**
+         * Leader: assigns a start time on the shared timeline to a scene,
+         * distributes it to the group and schedules it locally.
+         */
+        void broadcast_scene_(const GroupScene &scene)
+        {
+            auto start = micros() + lead_time_ * 1000;
+            auto id = ++scene_sequence_;
+            send_(SYNC_TYPE_SCENE, broadcast_, write_scene_(tx_ + SYNC_HEADER_SIZE, scene, id, start));
+            schedule_scene_(scene, id, start);
+        }
+
+        void schedule_scene_(const GroupScene &scene, uint16_t id, uint32_t start)
+        {
+            if (!has_clock_offset()) {
+                ESP_LOGW(TAG_SYNC, "Scene %u ignored, clock not yet synchronized", id);
+                return;
+            }
+            scene_ = scene;
+            scene_id_ = id;
+            scene_local_start_ = start - offset_;
+            scene_pending_ = true;
+        }
+
+        void start_scene_()
+        {
+            scene_pending_ = false;
+            // The light state loops before this component, so the first
+            // frame is written in the next iteration. Don't let that wait.
+            scene_starting_ = true;
+
+            // When starting late, shorten the transition to still end at
+            // the same time as the other lamps.
+            auto late = static_cast<int32_t>(micros() - scene_local_start_);
+            auto late_ms = static_cast<uint32_t>(late / 1000);
+            auto duration = scene_.duration > late_ms ? scene_.duration - late_ms : 0;
+
+            auto call = state_->make_call();
+            call.set_state(scene_.state);
+            if (scene_.state) {
+                call.set_brightness(scene_.brightness);
+                if (scene_.white)
+                    call.set_color_temperature(scene_.temperature);
+                else
+                    call.set_rgb(scene_.red, scene_.green, scene_.blue);
+            }
+            call.set_transition_length(duration);
+            call.perform();
+
+            skew_.lamp_id = id_;
+            skew_.scene = scene_id_;
+            skew_.skew = late;
+            skew_.rtt = leader_ ? 0 : offset_rtt_;
+            ESP_LOGD(TAG_SYNC, "Scene %u started, skew %d us, clock offset error <= %u us",
+                     scene_id_, skew_.skew, skew_.rtt / 2);
+
+            if (leader_) {
+                handle_report_(id_, skew_.scene, skew_.skew, skew_.rtt);
+            } else {
+                write_uint16_(tx_ + SYNC_HEADER_SIZE, skew_.scene);
+                write_uint32_(tx_ + SYNC_HEADER_SIZE + 2, skew_.skew);
+                write_uint32_(tx_ + SYNC_HEADER_SIZE + 6, skew_.rtt);
+                send_(SYNC_TYPE_REPORT, broadcast_, 10);
+            }
+        }
+
+        void handle_report_(uint32_t lamp_id, uint16_t scene, int32_t skew, uint32_t rtt)
+        {
+            GroupLampSkew *slot = nullptr;
+            for (auto &lamp : lamp_skews_) {
+                if (lamp.lamp_id == lamp_id || (slot == nullptr && lamp.lamp_id == 0))
+                    slot = &lamp;
+                if (lamp.lamp_id == lamp_id)
+                    break;
+            }
+            if (slot == nullptr)
+                return;
+            slot->lamp_id = lamp_id;
+            slot->scene = scene;
+            slot->skew = skew;
+            slot->rtt = rtt;
+            ESP_LOGI(TAG_SYNC, "Lamp %08x, scene %u: skew %d us, clock offset error <= %u us",
+                     lamp_id, scene, skew, rtt / 2);
+        }
+    };
+
+} // namespace rgbww
+} // namespace esphome
@@ -0,0 +1,292 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+
+namespace esphome {
+namespace rgbww {
+namespace yeelight_bs2 {
+
+// The maximum number of parameters that is kept for a single command.
+// The largest command in the Yeelight LAN protocol (start_cf) uses 3
+// parameters. get_prop can ask for more properties, but we only support
+// the ones that can be served by this device.
+static const size_t LAN_MAX_PARAMS = 8;
+
+// The maximum number of digits for an integer. Longer integers might not
+// fit in a long (32 bits on the ESP32), and are rejected.
+static const size_t LAN_MAX_DIGITS = 9;
+
+/**
+ * Parses an optionally negative integer of at most LAN_MAX_DIGITS digits.
+ * On success, pos is moved to the first character after the integer.
+ */
+inline bool parse_lan_integer(const char *&pos, const char *end, long &number)
+{
+    auto digits = pos < end && *pos == '-' ? pos + 1 : pos;
+    auto p = digits;
+    long value = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (static_cast<size_t>(p - digits) == LAN_MAX_DIGITS)
+            return false;
+        value = value * 10 + (*p++ - '0');
+    }
+    if (p == digits)
+        return false;
+    number = digits == pos ? value : -value;
+    pos = p;
+    return true;
+}
+
+/**
+ * A scalar JSON value. Strings are not copied or unescaped: the value
+ * points directly into the buffer from which the command was parsed.
+ */
+struct LanValue {
+    enum Type { NONE, NUMBER, STRING, BOOLEAN, OTHER };
+
+    Type type = NONE;
+    long number = 0;
+    const char *str = nullptr;
+    size_t len = 0;
+
+    bool is_string(const char *value) const
+    {
+        return type == STRING && strlen(value) == len && strncmp(str, value, len) == 0;
+    }
+};
+
+/**
+ * A command as sent by a Yeelight LAN protocol client, e.g.
+ * {"id":1,"method":"set_rgb","params":[16711680,"smooth",500]}
+ */
+struct LanCommand {
+    bool has_id = false;
+    long id = 0;
+    LanValue method;
+    LanValue params[LAN_MAX_PARAMS];
+    size_t param_count = 0;
+
+    bool is_method(const char *name) const { return method.is_string(name); }
+
+    long number_param(size_t index, long default_value) const
+    {
+        if (index >= param_count || params[index].type != LanValue::NUMBER)
+            return default_value;
+        return params[index].number;
+    }
+};
+
+/**
+ * A minimal, non-allocating JSON parser for Yeelight LAN protocol commands.
+ *
+ * Only the structure that is used by the protocol is interpreted: a top
+ * level object with the keys "id", "method" and "params". Other keys and
+ * nested structures inside the parameters are validated and skipped.
+ */
+class LanCommandParser
+{
+public:
+    /**
+     * Parses a single command from the provided buffer. The buffer does
+     * not have to be null terminated. Returns false on invalid input.
+     */
+    bool parse(const char *json, size_t len, LanCommand &command)
+    {
+        pos_ = json;
+        end_ = json + len;
+        command = LanCommand();
+
+        if (!consume_('{'))
+            return false;
+        if (consume_('}'))
+            return true;
+        do {
+            LanValue key;
+            if (!parse_string_(key) || !consume_(':'))
+                return false;
+            if (key.is_string("id")) {
+                if (!parse_scalar_(key) || key.type != LanValue::NUMBER)
+                    return false;
+                command.has_id = true;
+                command.id = key.number;
+            } else if (key.is_string("method")) {
+                if (!parse_string_(command.method))
+                    return false;
+            } else if (key.is_string("params")) {
+                if (!parse_params_(command))
+                    return false;
+            } else if (!skip_value_(0)) {
+                return false;
+            }
+        } while (consume_(','));
+        if (!consume_('}'))
+            return false;
+
+        skip_whitespace_();
+        return pos_ == end_;
+    }
+
+protected:
+    // The maximum nesting depth for skipped values.
+    static const int MAX_DEPTH = 8;
+
+    const char *pos_ = nullptr;
+    const char *end_ = nullptr;
+
+    void skip_whitespace_()
+    {
+        while (pos_ < end_ && (*pos_ == ' ' || *pos_ == '\t' || *pos_ == '\r' || *pos_ == '\n'))
+            pos_++;
+    }
+
+    bool consume_(char c)
+    {
+        skip_whitespace_();
+        if (pos_ < end_ && *pos_ == c) {
+            pos_++;
+            return true;
+        }
+        return false;
+    }
+
+    bool peek_(char c)
+    {
+        skip_whitespace_();
+        return pos_ < end_ && *pos_ == c;
+    }
+
+    bool parse_params_(LanCommand &command)
+    {
+        if (!consume_('['))
+            return false;
+        if (consume_(']'))
+            return true;
+        do {
+            LanValue value;
+            if (peek_('[') || peek_('{')) {
+                if (!skip_value_(0))
+                    return false;
+                value.type = LanValue::OTHER;
+            } else if (!parse_scalar_(value)) {
+                return false;
+            }
+            if (command.param_count < LAN_MAX_PARAMS)
+                command.params[command.param_count++] = value;
+        } while (consume_(','));
+        return consume_(']');
+    }
+
+    bool parse_string_(LanValue &value)
+    {
+        if (!consume_('"'))
+            return false;
+        value.type = LanValue::STRING;
+        value.str = pos_;
+        while (pos_ < end_ && *pos_ != '"') {
+            if (*pos_ == '\\')
+                pos_++;
+            pos_++;
+        }
+        if (pos_ >= end_)
+            return false;
+        value.len = pos_ - value.str;
+        pos_++;
+        return true;
+    }
+
+    bool parse_number_(LanValue &value)
+    {
+        long number;
+        if (!parse_lan_integer(pos_, end_, number))
+            return false;
+        // The protocol only uses integers. A fraction and an exponent are
+        // accepted (following the JSON number grammar), but truncated.
+        if (pos_ < end_ && *pos_ == '.' && !skip_digits_(pos_ + 1))
+            return false;
+        if (pos_ < end_ && (*pos_ == 'e' || *pos_ == 'E')) {
+            auto exponent = pos_ + 1;
+            if (exponent < end_ && (*exponent == '+' || *exponent == '-'))
+                exponent++;
+            if (!skip_digits_(exponent))
+                return false;
+        }
+        value.type = LanValue::NUMBER;
+        value.number = number;
+        return true;
+    }
+
+    /**
+     * Moves pos_ past the run of digits that starts at the provided
+     * position. Returns false when there is no digit at that position.
+     */
+    bool skip_digits_(const char *start)
+    {
+        auto p = start;
+        while (p < end_ && *p >= '0' && *p <= '9')
+            p++;
+        if (p == start)
+            return false;
+        pos_ = p;
+        return true;
+    }
+
+    bool parse_literal_(const char *literal)
+    {
+        auto len = strlen(literal);
+        if (static_cast<size_t>(end_ - pos_) < len || strncmp(pos_, literal, len) != 0)
+            return false;
+        pos_ += len;
+        return true;
+    }
+
+    bool parse_scalar_(LanValue &value)
+    {
+        skip_whitespace_();
+        if (pos_ >= end_)
+            return false;
+        if (*pos_ == '"')
+            return parse_string_(value);
+        if (*pos_ == 't' || *pos_ == 'f') {
+            value.type = LanValue::BOOLEAN;
+            value.number = *pos_ == 't';
+            return parse_literal_(value.number ? "true" : "false");
+        }
+        if (*pos_ == 'n') {
+            value.type = LanValue::OTHER;
+            return parse_literal_("null");
+        }
+        return parse_number_(value);
+    }
+
+    bool skip_value_(int depth)
+    {
+        if (depth > MAX_DEPTH)
+            return false;
+        if (consume_('[')) {
+            if (consume_(']'))
+                return true;
+            do {
+                if (!skip_value_(depth + 1))
+                    return false;
+            } while (consume_(','));
+            return consume_(']');
+        }
+        if (consume_('{')) {
+            if (consume_('}'))
+                return true;
+            do {
+                LanValue key;
+                if (!parse_string_(key) || !consume_(':') || !skip_value_(depth + 1))
+                    return false;
+            } while (consume_(','));
+            return consume_('}');
+        }
+        LanValue value;
+        return parse_scalar_(value);
+    }
+};
+
+} // namespace yeelight_bs2
+} // namespace rgbww
+} // namespace esphome
@@ -0,0 +1,629 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdarg>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#ifdef ARDUINO_ARCH_ESP32
+#include <lwip/sockets.h>
+#else
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
+#include "esphome/core/component.h"
+#include "esphome/core/helpers.h"
+#include "esphome/components/light/light_state.h"
+#include "yeelight_bs2_light_output.h"
+#include "yeelight_lan_json.h"
+
+namespace esphome {
+namespace rgbww {
+
+    static const char *TAG_LAN = "yeelight_bs2.lan";
+
+    // The default port, as used by the original Yeelight firmware.
+    static const uint16_t LAN_DEFAULT_PORT = 55443;
+
+    // The original firmware accepts up to 4 simultaneous connections.
+    static const size_t LAN_MAX_CLIENTS = 4;
+
+    // Buffer sizes per client connection. A command line that does not
+    // fit in the receive buffer results in the connection being closed.
+    static const size_t LAN_RX_BUFFER_SIZE = 512;
+    static const size_t LAN_TX_BUFFER_SIZE = 512;
+
+    // The space that must be available in the transmit buffer before the
+    // next command is handled. This is used for applying back pressure
+    // on clients that pipeline requests without reading the responses.
+    static const size_t LAN_MAX_RESPONSE_SIZE = 200;
+
+    // The maximum number of steps in a color flow (start_cf).
+    static const size_t LAN_MAX_FLOW_STEPS = 16;
+
+    // Same range as supported by the original Yeelight firmware.
+    static const int LAN_KELVIN_MIN = 1700;
+    static const int LAN_KELVIN_MAX = 6500;
+
+    /**
+     * This component implements the Yeelight LAN control protocol: JSON
+     * commands, separated by "\r\n", over a plain TCP connection. See the
+     * "Yeelight WiFi Light Inter-Operation Specification" for details.
+     *
+     * Commands are translated into light calls on the light state of
+     * the YeelightBS2LightOutput. This way, the lamp state is kept in
+     * sync with Home Assistant, and transitions are handled the same way
+     * as for commands that come in through the API.
+     *
+     * Multiple commands can be pipelined over a single connection. All
+     * buffers are statically allocated; no heap is used for handling
+     * commands.
+     *
+     * The light state writes a new state to the output in its next loop
+     * iteration. To not have that wait for the application loop interval,
+     * a high frequency loop is requested until the output has handled it.
+     * The time from receiving a command up to that point is measured.
+     */
+    class YeelightLanServer : public Component
+    {
+    public:
+        void set_light_state(light::LightState *state) { state_ = state; }
+
+        void set_output(YeelightBS2LightOutput *output) { output_ = output; }
+
+        void set_port(uint16_t port) { port_ = port; }
+
+        float get_setup_priority() const override { return setup_priority::AFTER_WIFI; }
+
+        void setup() override
+        {
+            output_->add_on_state_written_callback([this]() { on_state_written_(); });
+
+            server_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+            if (server_fd_ < 0) {
+                ESP_LOGE(TAG_LAN, "Could not create server socket (errno %d)", errno);
+                mark_failed();
+                return;
+            }
+            int enable = 1;
+            setsockopt(server_fd_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+            struct sockaddr_in address;
+            memset(&address, 0, sizeof(address));
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_ANY);
+            address.sin_port = htons(port_);
+            if (bind(server_fd_, (struct sockaddr *) &address, sizeof(address)) < 0 ||
+                listen(server_fd_, LAN_MAX_CLIENTS) < 0) {
+                ESP_LOGE(TAG_LAN, "Could not listen on port %u (errno %d)", port_, errno);
+                close(server_fd_);
+                server_fd_ = -1;
+                mark_failed();
+                return;
+            }
+            set_non_blocking_(server_fd_);
+        }
+
+        void dump_config() override
+        {
+            ESP_LOGCONFIG(TAG_LAN, "Yeelight LAN protocol server:");
+            ESP_LOGCONFIG(TAG_LAN, "  Port: %u", port_);
+        }
+
+        void loop() override
+        {
+            accept_clients_();
+            for (auto &client : clients_) {
+                if (client.fd < 0)
+                    continue;
+                receive_(client);
+                handle_commands_(client);
+                flush_(client);
+            }
+            run_flow_();
+        }
+
+        /**
+         * The number of commands that were handled since startup.
+         */
+        uint32_t get_commands_handled() const { return commands_handled_; }
+
+        /**
+         * The time between handling the last measured command, and the
+         * resulting light state being written to the LEDs (microseconds).
+         * When multiple commands are handled before the next write, the
+         * first one is measured.
+         */
+        uint32_t get_last_latency() const { return last_latency_; }
+
+    protected:
+        struct Client {
+            int fd = -1;
+            char rx[LAN_RX_BUFFER_SIZE];
+            size_t rx_len = 0;
+            char tx[LAN_TX_BUFFER_SIZE];
+            size_t tx_len = 0;
+        };
+
+        struct FlowStep {
+            uint32_t duration;
+            long mode;
+            long value;
+            long brightness;
+        };
+
+        light::LightState *state_;
+        YeelightBS2LightOutput *output_;
+        uint16_t port_ = LAN_DEFAULT_PORT;
+        int server_fd_ = -1;
+        Client clients_[LAN_MAX_CLIENTS];
+        yeelight_bs2::LanCommandParser parser_;
+        yeelight_bs2::LanCommand command_;
+        uint32_t commands_handled_ = 0;
+        uint32_t command_time_ = 0;
+        uint32_t latency_start_ = 0;
+        uint32_t last_latency_ = 0;
+        bool latency_pending_ = false;
+        HighFrequencyLoopRequester high_frequency_;
+
+        FlowStep flow_[LAN_MAX_FLOW_STEPS];
+        size_t flow_length_ = 0;
+        size_t flow_step_ = 0;
+        long flow_count_ = 0;
+        long flow_changes_ = 0;
+        long flow_action_ = 0;
+        uint32_t flow_next_ = 0;
+        bool flowing_ = false;
+        light::LightColorValues flow_recover_;
+
+        void set_non_blocking_(int fd)
+        {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        }
+
+        void accept_clients_()
+        {
+            if (server_fd_ < 0)
+                return;
+            for (;;) {
+                int fd = accept(server_fd_, nullptr, nullptr);
+                if (fd < 0)
+                    return;
+                Client *free_client = nullptr;
+                for (auto &client : clients_)
+                    if (client.fd < 0) {
+                        free_client = &client;
+                        break;
+                    }
+                if (free_client == nullptr) {
+                    ESP_LOGW(TAG_LAN, "Too many clients, connection refused");
+                    close(fd);
+                    continue;
+                }
+                set_non_blocking_(fd);
+                int enable = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+                free_client->fd = fd;
+                free_client->rx_len = 0;
+                free_client->tx_len = 0;
+                ESP_LOGD(TAG_LAN, "Client connected");
+            }
+        }
+
+        void disconnect_(Client &client)
+        {
+            close(client.fd);
+            client.fd = -1;
+            ESP_LOGD(TAG_LAN, "Client disconnected");
+        }
+
+        void receive_(Client &client)
+        {
+            auto space = LAN_RX_BUFFER_SIZE - client.rx_len;
+            if (space == 0) {
+                // Wait for pending commands to be handled first.
+                if (memchr(client.rx, '\n', client.rx_len) != nullptr)
+                    return;
+                ESP_LOGW(TAG_LAN, "Command too long, closing connection");
+                disconnect_(client);
+                return;
+            }
+            auto received = recv(client.fd, client.rx + client.rx_len, space, 0);
+            if (received > 0)
+                client.rx_len += received;
+            else if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+                disconnect_(client);
+        }
+
+        void handle_commands_(Client &client)
+        {
+            size_t start = 0;
+            while (client.fd >= 0 && LAN_TX_BUFFER_SIZE - client.tx_len >= LAN_MAX_RESPONSE_SIZE) {
+                auto line_end = static_cast<char *>(
+                    memchr(client.rx + start, '\n', client.rx_len - start));
+                if (line_end == nullptr)
+                    break;
+                auto line_len = line_end - (client.rx + start);
+                if (line_len > 0 && client.rx[start + line_len - 1] == '\r')
+                    line_len--;
+                if (line_len > 0)
+                    handle_command_(client, client.rx + start, line_len);
+                start = line_end - client.rx + 1;
+            }
+            if (start > 0) {
+                client.rx_len -= start;
+                memmove(client.rx, client.rx + start, client.rx_len);
+            }
+        }
+
+        void flush_(Client &client)
+        {
+            if (client.fd < 0 || client.tx_len == 0)
+                return;
+            auto sent = send(client.fd, client.tx, client.tx_len, 0);
+            if (sent > 0) {
+                client.tx_len -= sent;
+                memmove(client.tx, client.tx + sent, client.tx_len);
+            } else if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                disconnect_(client);
+            }
+        }
+
+        __attribute__((format(printf, 3, 4)))
+        void write_(Client &client, const char *format, ...)
+        {
+            va_list args;
+            va_start(args, format);
+            auto space = LAN_TX_BUFFER_SIZE - client.tx_len;
+            auto len = vsnprintf(client.tx + client.tx_len, space, format, args);
+            va_end(args);
+            if (len > 0 && static_cast<size_t>(len) < space)
+                client.tx_len += len;
+        }
+
+        void reply_ok_(Client &client)
+        {
+            write_(client, "{\"id\":%ld,\"result\":[\"ok\"]}\r\n", command_.id);
+        }
+
+        void reply_error_(Client &client, const char *message)
+        {
+            write_(client, "{\"id\":%ld,\"error\":{\"code\":-1,\"message\":\"%s\"}}\r\n",
+                   command_.id, message);
+        }
+
+        void handle_command_(Client &client, const char *json, size_t len)
+        {
+            command_time_ = micros();
+            if (!parser_.parse(json, len, command_) || !command_.has_id ||
+                command_.method.type != yeelight_bs2::LanValue::STRING) {
+                command_.id = 0;
+                reply_error_(client, "invalid command");
+                return;
+            }
+            commands_handled_++;
+
+            if (command_.is_method("get_prop")) {
+                reply_props_(client);
+                return;
+            }
+
+            bool ok;
+            if (command_.is_method("set_power"))
+                ok = set_power_();
+            else if (command_.is_method("toggle"))
+                ok = toggle_();
+            else if (command_.is_method("set_bright"))
+                ok = set_bright_();
+            else if (command_.is_method("set_rgb"))
+                ok = set_rgb_();
+            else if (command_.is_method("set_hsv"))
+                ok = set_hsv_();
+            else if (command_.is_method("set_ct_abx"))
+                ok = set_ct_abx_();
+            else if (command_.is_method("start_cf"))
+                ok = start_cf_();
+            else if (command_.is_method("stop_cf"))
+                ok = stop_cf_();
+            else {
+                reply_error_(client, "method not supported");
+                return;
+            }
+
+            if (ok)
+                reply_ok_(client);
+            else
+                reply_error_(client, "invalid params");
+        }
+
+        /**
+         * Performs the light call for the command that is being handled,
+         * and starts measuring the time until it reaches the LEDs.
+         */
+        void perform_(light::LightCall &call)
+        {
+            call.perform();
+            if (latency_pending_)
+                return;
+            latency_pending_ = true;
+            latency_start_ = command_time_;
+            high_frequency_.start();
+        }
+
+        void on_state_written_()
+        {
+            if (!latency_pending_)
+                return;
+            latency_pending_ = false;
+            last_latency_ = micros() - latency_start_;
+            high_frequency_.stop();
+            ESP_LOGV(TAG_LAN, "Command applied to the LEDs in %u us", last_latency_);
+        }
+
+        /**
+         * Applies the "effect" and "duration" parameters, which are used by
+         * most of the commands, to a light call.
+         */
+        void apply_transition_(light::LightCall &call, size_t effect_index)
+        {
+            uint32_t duration = 0;
+            if (effect_index < command_.param_count &&
+                command_.params[effect_index].is_string("smooth")) {
+                // Like the original firmware, enforce a minimum duration.
+                auto requested = command_.number_param(effect_index + 1, 30);
+                duration = requested < 30 ? 30 : requested;
+            }
+            call.set_transition_length(duration);
+        }
+
+        bool set_power_()
+        {
+            if (command_.param_count < 1)
+                return false;
+            bool on = command_.params[0].is_string("on");
+            if (!on && !command_.params[0].is_string("off"))
+                return false;
+            stop_flow_();
+            auto call = state_->make_call();
+            call.set_state(on);
+            // Power on mode 5 = night light mode. This maps on the night light
+            // mode of the YeelightBS2LightOutput (white RGB at 1% brightness).
+            if (on && command_.number_param(3, 0) == 5) {
+                call.set_rgb(1.0f, 1.0f, 1.0f);
+                call.set_brightness(0.01f);
+            }
+            apply_transition_(call, 1);
+            perform_(call);
+            return true;
+        }
+
+        bool toggle_()
+        {
+            stop_flow_();
+            auto call = state_->toggle();
+            perform_(call);
+            return true;
+        }
+
+        bool set_bright_()
+        {
+            auto bright = command_.number_param(0, -1);
+            if (bright < 1 || bright > 100)
+                return false;
+            stop_flow_();
+            auto call = state_->make_call();
+            call.set_brightness(bright / 100.0f);
+            apply_transition_(call, 1);
+            perform_(call);
+            return true;
+        }
+
+        bool set_rgb_()
+        {
+            auto rgb = command_.number_param(0, -1);
+            if (rgb < 0 || rgb > 0xFFFFFF)
+                return false;
+            stop_flow_();
+            auto call = state_->make_call();
+            set_rgb_on_call_(call, rgb);
+            apply_transition_(call, 1);
+            perform_(call);
+            return true;
+        }
+
+        bool set_hsv_()
+        {
+            auto hue = command_.number_param(0, -1);
+            auto sat = command_.number_param(1, -1);
+            if (hue < 0 || hue > 359 || sat < 0 || sat > 100)
+                return false;
+            stop_flow_();
+            float red, green, blue;
+            hsv_to_rgb_(hue, sat / 100.0f, red, green, blue);
+            auto call = state_->make_call();
+            call.set_rgb(red, green, blue);
+            apply_transition_(call, 2);
+            perform_(call);
+            return true;
+        }
+
+        bool set_ct_abx_()
+        {
+            auto kelvin = command_.number_param(0, -1);
+            if (kelvin < LAN_KELVIN_MIN || kelvin > LAN_KELVIN_MAX)
+                return false;
+            stop_flow_();
+            auto call = state_->make_call();
+            call.set_color_temperature(1000000.0f / kelvin);
+            apply_transition_(call, 1);
+            perform_(call);
+            return true;
+        }
+
+        /**
+         * Starts a color flow. The flow expression is a string containing
+         * a flat list of "duration,mode,value,brightness" tuples.
+         * Mode 1 = RGB color, 2 = color temperature, 7 = sleep.
+         */
+        bool start_cf_()
+        {
+            auto count = command_.number_param(0, -1);
+            auto action = command_.number_param(1, -1);
+            if (count < 0 || action < 0 || action > 2 || command_.param_count < 3 ||
+                command_.params[2].type != yeelight_bs2::LanValue::STRING)
+                return false;
+
+            long numbers[LAN_MAX_FLOW_STEPS * 4];
+            size_t number_count = 0;
+            auto expression = command_.params[2];
+            auto pos = expression.str;
+            auto end = expression.str + expression.len;
+            while (pos < end) {
+                if (number_count == LAN_MAX_FLOW_STEPS * 4 ||
+                    !yeelight_bs2::parse_lan_integer(pos, end, numbers[number_count++]))
+                    return false;
+                while (pos < end && (*pos == ',' || *pos == ' '))
+                    pos++;
+            }
+            if (number_count == 0 || number_count % 4 != 0)
+                return false;
+
+            if (!flowing_)
+                flow_recover_ = state_->remote_values;
+            flow_length_ = number_count / 4;
+            for (size_t i = 0; i < flow_length_; i++) {
+                flow_[i].duration = numbers[i * 4] < 50 ? 50 : numbers[i * 4];
+                flow_[i].mode = numbers[i * 4 + 1];
+                flow_[i].value = numbers[i * 4 + 2];
+                flow_[i].brightness = numbers[i * 4 + 3];
+            }
+            flow_count_ = count;
+            flow_action_ = action;
+            flow_step_ = 0;
+            flow_changes_ = 0;
+            flow_next_ = millis();
+            flowing_ = true;
+            return true;
+        }
+
+        bool stop_cf_()
+        {
+            stop_flow_();
+            return true;
+        }
+
+        void stop_flow_()
+        {
+            flowing_ = false;
+        }
+
+        void run_flow_()
+        {
+            if (!flowing_ || static_cast<int32_t>(millis() - flow_next_) < 0)
+                return;
+
+            if (flow_count_ > 0 && flow_changes_ >= flow_count_) {
+                finish_flow_();
+                return;
+            }
+
+            auto &step = flow_[flow_step_];
+            if (step.mode != 7) {
+                auto call = state_->make_call();
+                call.set_state(true);
+                if (step.mode == 1)
+                    set_rgb_on_call_(call, step.value);
+                else if (step.mode == 2 && step.value >= LAN_KELVIN_MIN && step.value <= LAN_KELVIN_MAX)
+                    call.set_color_temperature(1000000.0f / step.value);
+                if (step.brightness >= 1 && step.brightness <= 100)
+                    call.set_brightness(step.brightness / 100.0f);
+                call.set_transition_length(step.duration);
+                call.perform();
+            }
+
+            flow_changes_++;
+            flow_next_ += step.duration;
+            flow_step_ = (flow_step_ + 1) % flow_length_;
+        }
+
+        void finish_flow_()
+        {
+            flowing_ = false;
+            if (flow_action_ == 0) {
+                auto call = state_->make_call();
+                call.set_state(flow_recover_.get_state() > 0);
+                call.set_brightness(flow_recover_.get_brightness());
+                call.set_rgb(flow_recover_.get_red(), flow_recover_.get_green(), flow_recover_.get_blue());
+                if (flow_recover_.get_red() == 1 && flow_recover_.get_green() == 1 && flow_recover_.get_blue() == 1)
+                    call.set_color_temperature(flow_recover_.get_color_temperature());
+                call.perform();
+            } else if (flow_action_ == 2) {
+                state_->turn_off().perform();
+            }
+        }
+
+        void reply_props_(Client &client)
+        {
+            auto values = state_->remote_values;
+            bool ct_mode =
+                values.get_red() == 1 && values.get_green() == 1 && values.get_blue() == 1;
+            auto mireds = values.get_color_temperature();
+            long kelvin = mireds > 0 ? lroundf(1000000.0f / mireds) : 0;
+            long rgb =
+                (lroundf(values.get_red() * 255) << 16) |
+                (lroundf(values.get_green() * 255) << 8) |
+                lroundf(values.get_blue() * 255);
+
+            write_(client, "{\"id\":%ld,\"result\":[", command_.id);
+            for (size_t i = 0; i < command_.param_count; i++) {
+                auto &prop = command_.params[i];
+                const char *separator = i == 0 ? "" : ",";
+                if (prop.is_string("power"))
+                    write_(client, "%s\"%s\"", separator, values.get_state() > 0 ? "on" : "off");
+                else if (prop.is_string("bright"))
+                    write_(client, "%s\"%ld\"", separator, lroundf(values.get_brightness() * 100));
+                else if (prop.is_string("ct"))
+                    write_(client, "%s\"%ld\"", separator, kelvin);
+                else if (prop.is_string("rgb"))
+                    write_(client, "%s\"%ld\"", separator, rgb);
+                else if (prop.is_string("color_mode"))
+                    write_(client, "%s\"%d\"", separator, ct_mode ? 2 : 1);
+                else if (prop.is_string("flowing"))
+                    write_(client, "%s\"%d\"", separator, flowing_ ? 1 : 0);
+                else
+                    write_(client, "%s\"\"", separator);
+            }
+            write_(client, "]}\r\n");
+        }
+
+        void set_rgb_on_call_(light::LightCall &call, long rgb)
+        {
+            call.set_rgb(
+                ((rgb >> 16) & 0xFF) / 255.0f,
+                ((rgb >> 8) & 0xFF) / 255.0f,
+                (rgb & 0xFF) / 255.0f);
+        }
+
+        void hsv_to_rgb_(long hue, float saturation, float &red, float &green, float &blue)
+        {
+            auto h = hue / 60.0f;
+            auto x = 1.0f - fabsf(fmodf(h, 2.0f) - 1.0f);
+            float r, g, b;
+            if (h < 1) { r = 1; g = x; b = 0; }
+            else if (h < 2) { r = x; g = 1; b = 0; }
+            else if (h < 3) { r = 0; g = 1; b = x; }
+            else if (h < 4) { r = 0; g = x; b = 1; }
+            else if (h < 5) { r = x; g = 0; b = 1; }
+            else { r = 1; g = 0; b = x; }
+            red = 1.0f - saturation * (1.0f - r);
+            green = 1.0f - saturation * (1.0f - g);
+            blue = 1.0f - saturation * (1.0f - b);
+        }
+    };
+
+} // namespace rgbww
+} // namespace esphome
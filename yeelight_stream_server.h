@@ -0,0 +1,316 @@
+#pragma once
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <unistd.h>
+#ifdef ARDUINO_ARCH_ESP32
+#include <lwip/sockets.h>
+#else
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+#include "esphome/core/component.h"
+#include "esphome/core/helpers.h"
+#include "yeelight_bs2_light_output.h"
+
+namespace esphome {
+namespace rgbww {
+
+    static const char *TAG_STREAM = "yeelight_bs2.stream";
+
+    // The default port, as used by the Distributed Display Protocol (DDP).
+    static const uint16_t STREAM_DEFAULT_PORT = 4048;
+
+    // The default time after which control is handed back to the light
+    // state when no more frames are received.
+    static const uint32_t STREAM_DEFAULT_TIMEOUT = 2500;
+
+    // A packet that is received this long after the last applied frame is
+    // not treated as late, but as the start of a new run of packets after
+    // 8 or more lost packets (which is indistinguishable from being late
+    // by sequence number alone).
+    static const uint32_t STREAM_RESYNC_TIME = 100;
+
+    // The same goes for this number of consecutive packets, of which each
+    // packet would be considered late.
+    static const uint8_t STREAM_RESYNC_RUN = 3;
+
+    // DDP header flags.
+    static const uint8_t DDP_FLAGS_VERSION_MASK = 0xC0;
+    static const uint8_t DDP_FLAGS_VERSION_1 = 0x40;
+    static const uint8_t DDP_FLAGS_TIMECODE = 0x10;
+    static const uint8_t DDP_FLAGS_QUERY = 0x02;
+    static const size_t DDP_HEADER_SIZE = 10;
+    static const size_t DDP_TIMECODE_SIZE = 4;
+
+    // DDP data types. Of the standard data types, only RGB with 8 bits per
+    // channel is supported. Many senders set the type to 0x00 (undefined)
+    // or 0x01 (from an earlier version of the protocol) for that. Other
+    // standard types (e.g. RGBW, grayscale or 16 bits per channel) are
+    // dropped, since their values would be applied as the wrong color.
+    // Types with the high bit set are customer-defined, and these are
+    // used for the device-specific frame formats:
+    // - RGB + brightness: red, green, blue, brightness (4 x uint8)
+    // - white: color temperature in mireds (uint16), brightness (uint8)
+    // - duties: red, green, blue, white duty cycles (4 x uint16)
+    // All multi-byte values are big-endian, like the DDP header.
+    static const uint8_t DDP_TYPE_UNDEFINED = 0x00;
+    static const uint8_t DDP_TYPE_RGB_LEGACY = 0x01;
+    static const uint8_t DDP_TYPE_RGB8 = 0x0B;
+    static const uint8_t DDP_TYPE_RGB_BRIGHTNESS = 0x80;
+    static const uint8_t DDP_TYPE_WHITE = 0x81;
+    static const uint8_t DDP_TYPE_DUTIES = 0x82;
+
+    // Large enough for a header with timecode, plus the largest payload.
+    // Longer datagrams (e.g. DDP frames for LED strips) are truncated;
+    // only the first pixel is used.
+    static const size_t STREAM_BUFFER_SIZE = 32;
+
+    /**
+     * This component accepts realtime color frames over UDP, using the
+     * framing of the Distributed Display Protocol (DDP), and applies them
+     * directly to the YeelightBS2LightOutput. This bypasses the light state
+     * and its transitions, for low latency ambient sync and light shows.
+     *
+     * The first received frame puts the output in streaming mode. When
+     * no frames are received for the configured timeout, the output
+     * returns to the light state as controlled through the API.
+     *
+     * The DDP sequence number is used for detecting lost packets (gaps
+     * in the sequence) and late packets (received after a newer packet).
+     * Late packets are not applied. Since sequence numbers wrap around
+     * after 15, a gap of 8 or more lost packets looks like a late packet.
+     * The sequence is resynchronized when such a packet arrives well
+     * after the last applied frame, or when a few consecutive packets
+     * all look late.
+     *
+     * While streaming, a high frequency loop is requested. Otherwise, a
+     * frame would wait for the application loop interval (16ms) before
+     * being applied, and at a frame rate of 50 - 100Hz about every other
+     * frame would be overwritten by the next one before that.
+     */
+    class YeelightStreamServer : public Component
+    {
+    public:
+        void set_output(YeelightBS2LightOutput *output) { output_ = output; }
+
+        void set_port(uint16_t port) { port_ = port; }
+
+        void set_timeout(uint32_t timeout) { timeout_ = timeout; }
+
+        float get_setup_priority() const override { return setup_priority::AFTER_WIFI; }
+
+        void setup() override
+        {
+            fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+            if (fd_ < 0) {
+                ESP_LOGE(TAG_STREAM, "Could not create socket (errno %d)", errno);
+                mark_failed();
+                return;
+            }
+            struct sockaddr_in address;
+            memset(&address, 0, sizeof(address));
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_ANY);
+            address.sin_port = htons(port_);
+            if (bind(fd_, (struct sockaddr *) &address, sizeof(address)) < 0) {
+                ESP_LOGE(TAG_STREAM, "Could not bind to port %u (errno %d)", port_, errno);
+                close(fd_);
+                fd_ = -1;
+                mark_failed();
+                return;
+            }
+            fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL, 0) | O_NONBLOCK);
+        }
+
+        void dump_config() override
+        {
+            ESP_LOGCONFIG(TAG_STREAM, "Yeelight stream server:");
+            ESP_LOGCONFIG(TAG_STREAM, "  Port: %u", port_);
+            ESP_LOGCONFIG(TAG_STREAM, "  Timeout: %u ms", timeout_);
+        }
+
+        void loop() override
+        {
+            if (fd_ < 0)
+                return;
+
+            // Read all pending datagrams. Only the most recent frame is
+            // applied, older frames would be overwritten right away.
+            auto now = millis();
+            bool has_frame = false;
+            for (;;) {
+                auto len = recv(fd_, buffer_, sizeof(buffer_), 0);
+                if (len < 0)
+                    break;
+                if (parse_(static_cast<size_t>(len), now))
+                    has_frame = true;
+            }
+
+            if (has_frame) {
+                if (!output_->is_streaming()) {
+                    output_->start_streaming();
+                    high_frequency_.start();
+                }
+                apply_();
+            } else if (output_->is_streaming() && now - last_frame_time_ > timeout_) {
+                ESP_LOGD(TAG_STREAM, "Stream timed out (received %u, lost %u, late %u)",
+                         packets_received_, packets_lost_, packets_late_);
+                output_->stop_streaming();
+                high_frequency_.stop();
+                last_sequence_ = 0;
+                late_run_ = 0;
+            }
+        }
+
+        uint32_t get_packets_received() const { return packets_received_; }
+
+        uint32_t get_packets_lost() const { return packets_lost_; }
+
+        uint32_t get_packets_late() const { return packets_late_; }
+
+    protected:
+        struct Frame {
+            uint8_t type;
+            float values[4];
+        };
+
+        YeelightBS2LightOutput *output_;
+        uint16_t port_ = STREAM_DEFAULT_PORT;
+        uint32_t timeout_ = STREAM_DEFAULT_TIMEOUT;
+        int fd_ = -1;
+        uint8_t buffer_[STREAM_BUFFER_SIZE];
+        Frame frame_;
+        uint8_t last_sequence_ = 0;
+        uint8_t late_sequence_ = 0;
+        uint8_t late_run_ = 0;
+        uint32_t last_frame_time_ = 0;
+        uint32_t packets_received_ = 0;
+        uint32_t packets_lost_ = 0;
+        uint32_t packets_late_ = 0;
+        HighFrequencyLoopRequester high_frequency_;
+
+        static uint16_t read_uint16_(const uint8_t *data)
+        {
+            return (data[0] << 8) | data[1];
+        }
+
+        /**
+         * Validates the datagram in the receive buffer, and stores it as
+         * the frame to apply. Returns false when the datagram must not
+         * be applied.
+         */
+        bool parse_(size_t len, uint32_t now)
+        {
+            if (len < DDP_HEADER_SIZE)
+                return false;
+            auto flags = buffer_[0];
+            if ((flags & DDP_FLAGS_VERSION_MASK) != DDP_FLAGS_VERSION_1 || (flags & DDP_FLAGS_QUERY))
+                return false;
+            // Only pixel 0 is supported, since the lamp is a single light.
+            if (buffer_[4] != 0 || buffer_[5] != 0 || buffer_[6] != 0 || buffer_[7] != 0)
+                return false;
+            auto header_size = DDP_HEADER_SIZE + ((flags & DDP_FLAGS_TIMECODE) ? DDP_TIMECODE_SIZE : 0);
+            auto type = buffer_[2];
+            size_t payload_size =
+                type == DDP_TYPE_RGB_BRIGHTNESS ? 4 :
+                type == DDP_TYPE_WHITE ? 3 :
+                type == DDP_TYPE_DUTIES ? 8 :
+                type == DDP_TYPE_UNDEFINED || type == DDP_TYPE_RGB_LEGACY || type == DDP_TYPE_RGB8 ? 3 : 0;
+            if (payload_size == 0 || len < header_size + payload_size ||
+                read_uint16_(buffer_ + 8) < payload_size)
+                return false;
+
+            packets_received_++;
+            if (!check_sequence_(buffer_[1] & 0x0F, now))
+                return false;
+            last_frame_time_ = now;
+
+            auto data = buffer_ + header_size;
+            frame_.type = type;
+            if (type == DDP_TYPE_WHITE) {
+                frame_.values[0] = read_uint16_(data);
+                frame_.values[1] = data[2] / 255.0f;
+            } else if (type == DDP_TYPE_DUTIES) {
+                for (size_t i = 0; i < 4; i++)
+                    frame_.values[i] = read_uint16_(data + i * 2) / 65535.0f;
+            } else {
+                for (size_t i = 0; i < payload_size; i++)
+                    frame_.values[i] = data[i] / 255.0f;
+            }
+            return true;
+        }
+
+        /**
+         * DDP sequence numbers run from 1 to 15. Sequence number 0 means
+         * that the sender does not use sequence numbers.
+         * Returns false for late packets.
+         */
+        bool check_sequence_(uint8_t sequence, uint32_t now)
+        {
+            if (sequence == 0)
+                return true;
+            if (last_sequence_ != 0) {
+                auto distance = (sequence - last_sequence_ + 15) % 15;
+                if (distance == 0 || distance > 7) {
+                    bool continues_run = late_run_ > 0 && sequence == late_sequence_ % 15 + 1;
+                    late_run_ = continues_run ? late_run_ + 1 : 1;
+                    late_sequence_ = sequence;
+                    if (now - last_frame_time_ < STREAM_RESYNC_TIME && late_run_ < STREAM_RESYNC_RUN) {
+                        packets_late_++;
+                        return false;
+                    }
+                    // The earlier packets of the run were not late after
+                    // all, only not applied. What remains of the gap since
+                    // the last applied frame was lost.
+                    ESP_LOGD(TAG_STREAM, "Resynchronizing at sequence number %u", sequence);
+                    packets_late_ -= late_run_ - 1;
+                    packets_lost_ += (distance == 0 ? 15 : distance) - late_run_;
+                } else {
+                    packets_lost_ += distance - 1;
+                }
+            }
+            late_run_ = 0;
+            last_sequence_ = sequence;
+            return true;
+        }
+
+        void apply_()
+        {
+            auto &v = frame_.values;
+            if (frame_.type == DDP_TYPE_DUTIES) {
+                output_->stream_duties(v[0], v[1], v[2], v[3]);
+            } else if (frame_.type == DDP_TYPE_WHITE) {
+                if (v[1] == 0)
+                    output_->stream_off();
+                else
+                    output_->stream_white(v[0], clamp_brightness_(v[1]));
+            } else if (frame_.type == DDP_TYPE_RGB_BRIGHTNESS) {
+                if (v[3] == 0 || (v[0] == 0 && v[1] == 0 && v[2] == 0))
+                    output_->stream_off();
+                else
+                    output_->stream_rgb(v[0], v[1], v[2], clamp_brightness_(v[3]));
+            } else {
+                // Plain RGB: the brightness is determined by the strongest
+                // color channel, like the light state does for RGB colors.
+                auto brightness = fmaxf(fmaxf(v[0], v[1]), v[2]);
+                if (brightness == 0)
+                    output_->stream_off();
+                else
+                    output_->stream_rgb(
+                        v[0] / brightness, v[1] / brightness, v[2] / brightness,
+                        clamp_brightness_(brightness));
+            }
+        }
+
+        static float clamp_brightness_(float brightness)
+        {
+            return brightness < 0.01f ? 0.01f : brightness;
+        }
+    };
+
+} // namespace rgbww
+} // namespace esphome